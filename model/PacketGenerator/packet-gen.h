@@ -4,9 +4,10 @@
 #include "ns3/object.h"
 #include "ns3/address.h"
 #include "ns3/ipv4-address.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
 
-#include <boost/unordered_map.hpp>
-#include <fstream>
+#include "trace-record.h"
 
 namespace ns3{
 
@@ -14,7 +15,10 @@ class NetDevice;
 class Packet;
 class Node;
 class Ipv4L3Protocol;
-  
+
+/* Sends the trace packets of a host, the records are read and dispatched
+ * by AppGen from the shared TraceReader.
+ */
 class PacketGenerator : public Object
 {
 
@@ -24,55 +28,54 @@ public:
 		  Ptr<Node>                       node,
 		  const Address&                  macAddr,
 		  const Ipv4Address&              ipv4Addr,
-		  const std::vector<Ipv4Address>& allAddr,
-		  const char*                     filename);
+		  const std::vector<Ipv4Address>& allAddr);
 
   ~PacketGenerator();
   
-  /* TODO: Start transmit.
+  /* Send the trace record now, its dst is mapped to a data center host.
    */
-  void StartGenerator(float endTime);
-
-  void Send( Ptr<Packet>        packet,
-	     const Ipv4Address& ipdst,
-	     uint16_t           portsrc,
-	     uint16_t           portdst,
-	     uint8_t            type);
+  void SendRecord(const TraceRecord_t& record);
 
 private:
 
-  /* TODO: Schedule the next SendPacket event
+  /* The headers and hardware address of a destination, built at its first packet.
+   * A packet only copies them.
    */
-  void ScheduleNextTx();
+  struct DstCache_t
+  {
+    DstCache_t() : built(false) {}
+
+    bool        built;
+    Ipv4Address ipdst;
+    Address     hwDst;
+    Ipv4Header  tcpIpHeader;   //the payload size is set per packet
+    Ipv4Header  udpIpHeader;
+    UdpHeader   udpHeader;     //checksum initialized, the ports are set per packet
+  };
 
-  /* TODO:
-   */
-  void SendPacket(Ipv4Address ipdst,
-		  uint16_t    portsrc,
-		  uint16_t    portdst,
-		  uint8_t     type,
-		  uint32_t    size);
-  
   /* Find the hardware destination address in the arp cache
    */
   Address GetHardwareDstAddr(Ptr<Ipv4L3Protocol> ipv4Impl,
 			     const Ipv4Address& ipdst);
 
-  /* Transform the ipdst into the data center host ip;
+  /* Transform the raw trace ipdst into the data center host ip idx(in m_allIPAddr),
+   * m_allIPAddr.size() is the broadcast. See TraceHost.
+   */
+  unsigned GetNewIPIdx(uint32_t rawAddr);
+
+  /* The cache of the dst ip idx, built if it's the first packet
    */
-  Ipv4Address GetNewIPAddress(const std::string& ipdst);
+  const DstCache_t& GetDstCache(unsigned ipIdx);
   
   int                      m_hostID;       //ID of the host that the pack gen is on 
   Address                  m_macAddr;      //mac addr of the host's net device
   Ipv4Address              m_ipv4Addr;     //ip of the host 
   Ptr<NetDevice>           m_device;       //host' net device
   Ptr<Node>                m_node;         //host' node
-  float                    m_lastTime;     //lastSendTime;
-  float                    m_endTime;
   
   std::vector<Ipv4Address>                 m_allIPAddr;  //other host ip addr in DC.
-  boost::unordered_map<uint32_t, unsigned> m_ipDict; //ip dict
-  std::ifstream                            m_file;         //packet file
+  std::vector<DstCache_t>                  m_dstCache;  //idx of m_allIPAddr, the last is broadcast
+  Ptr<Ipv4L3Protocol>                      m_ipv4Impl;
 };
 
 }
@@ -0,0 +1,335 @@
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/udp-l4-protocol.h"
+#include "ns3/tcp-l4-protocol.h"
+
+#include "pcap-reader.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("PcapReader");
+
+//pcap magics as the first 4 bytes of the file
+static const uint32_t PCAP_MAGIC_US    = 0xa1b2c3d4;
+static const uint32_t PCAP_MAGIC_NS    = 0xa1b23c4d;
+static const uint32_t PCAPNG_SHB       = 0x0a0d0d0a;
+static const uint32_t PCAPNG_BOM       = 0x1a2b3c4d;
+static const uint32_t PCAP_HEADER      = 24;
+static const uint32_t PCAP_REC_HEADER  = 16;
+
+//pcapng block types
+static const uint32_t PCAPNG_IDB       = 1;
+static const uint32_t PCAPNG_PB        = 2;   //obsolete packet block
+static const uint32_t PCAPNG_EPB       = 6;
+static const uint16_t PCAPNG_OPT_END   = 0;
+static const uint16_t PCAPNG_OPT_TSRESOL = 9;
+
+//link types
+static const uint32_t LINKTYPE_ETHERNET   = 1;
+static const uint32_t LINKTYPE_RAW        = 101;
+static const uint32_t LINKTYPE_LINUX_SLL  = 113;
+static const uint32_t LINKTYPE_IPV4       = 228;
+static const uint32_t LINKTYPE_LINUX_SLL2 = 276;
+
+static const uint16_t ETHERTYPE_IPV4   = 0x0800;
+static const uint16_t ETHERTYPE_VLAN   = 0x8100;
+static const uint16_t ETHERTYPE_QINQ   = 0x88a8;
+
+static inline uint16_t
+ReadBE16 (const uint8_t* p)
+{
+  return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t
+ReadBE32 (const uint8_t* p)
+{
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline uint32_t
+ReadLE32 (const uint8_t* p)
+{
+  return (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+}
+
+PcapReader::PcapReader ()
+  : m_data(NULL), m_size(0), m_pos(0), m_pcapng(false), m_bigEndian(false),
+    m_nanoSecond(false), m_linkType(0), m_started(false), m_firstNs(0)
+{
+}
+
+bool
+PcapReader::IsPcap (const uint8_t* data, size_t size)
+{
+  if(size < 4)
+    return false;
+  uint32_t be = ReadBE32(data);
+  uint32_t le = ReadLE32(data);
+  return be == PCAP_MAGIC_US || le == PCAP_MAGIC_US ||
+         be == PCAP_MAGIC_NS || le == PCAP_MAGIC_NS ||
+         be == PCAPNG_SHB;
+}
+
+uint16_t
+PcapReader::Read16 (const uint8_t* p) const
+{
+  return m_bigEndian ? ReadBE16(p) : (uint16_t)(p[1] << 8 | p[0]);
+}
+
+uint32_t
+PcapReader::Read32 (const uint8_t* p) const
+{
+  return m_bigEndian ? ReadBE32(p) : ReadLE32(p);
+}
+
+void
+PcapReader::Open (const uint8_t* data, size_t size)
+{
+  NS_ASSERT(IsPcap(data, size));
+  m_data    = data;
+  m_size    = size;
+  m_started = false;
+
+  if(ReadBE32(data) == PCAPNG_SHB)
+    {
+      //The byte order is set by each section header block
+      m_pcapng = true;
+      m_pos    = 0;
+      return;
+    }
+
+  if(size < PCAP_HEADER)
+    NS_FATAL_ERROR("pcap file is truncated");
+  m_pcapng     = false;
+  m_bigEndian  = (ReadBE32(data) == PCAP_MAGIC_US || ReadBE32(data) == PCAP_MAGIC_NS);
+  m_nanoSecond = (Read32(data) == PCAP_MAGIC_NS);
+  m_linkType   = Read32(data + 20) & 0x0fffffff;   //the upper bits are the FCS info
+  m_pos        = PCAP_HEADER;
+}
+
+bool
+PcapReader::NextPcap (const uint8_t*& data, uint32_t& capLen, uint32_t& origLen,
+		      uint32_t& linkType, int64_t& ns)
+{
+  if(m_pos + PCAP_REC_HEADER > m_size)
+    return false;
+
+  const uint8_t* rec = m_data + m_pos;
+  uint32_t sec  = Read32(rec);
+  uint32_t frac = Read32(rec + 4);
+  capLen  = Read32(rec + 8);
+  origLen = Read32(rec + 12);
+  if(m_pos + PCAP_REC_HEADER + capLen > m_size)
+    {
+      NS_LOG_WARN("pcap file is truncated");
+      return false;
+    }
+
+  data     = rec + PCAP_REC_HEADER;
+  linkType = m_linkType;
+  ns       = (int64_t)sec * 1000000000 + (m_nanoSecond ? frac : (int64_t)frac * 1000);
+  m_pos   += PCAP_REC_HEADER + capLen;
+  return true;
+}
+
+int64_t
+PcapReader::TimestampNs (uint64_t ts, uint32_t tsResol)
+{
+  uint32_t v = tsResol & 0x7f;
+  if(tsResol & 0x80)
+    {
+      //2^-v seconds
+      return (int64_t)((ts >> v) * 1000000000 + (((ts & ((1ull << v) - 1)) * 1000000000) >> v));
+    }
+
+  uint64_t scale = 1;
+  if(v <= 9)
+    {
+      for(uint32_t i = v; i < 9; ++i) scale *= 10;
+      return (int64_t)(ts * scale);
+    }
+  for(uint32_t i = 9; i < v; ++i) scale *= 10;
+  return (int64_t)(ts / scale);
+}
+
+void
+PcapReader::AddInterface (const uint8_t* body, uint32_t bodyLen)
+{
+  Interface_t itf;
+  itf.linkType = Read16(body);
+  itf.tsResol  = 6;   //microseconds if no if_tsresol
+
+  //options after linktype(2), reserved(2), snaplen(4)
+  uint32_t off = 8;
+  while(off + 4 <= bodyLen)
+    {
+      uint16_t code = Read16(body + off);
+      uint16_t len  = Read16(body + off + 2);
+      if(code == PCAPNG_OPT_END)
+	break;
+      if(code == PCAPNG_OPT_TSRESOL && len >= 1 && off + 5 <= bodyLen)
+	itf.tsResol = body[off + 4];
+      off += 4 + ((len + 3) & ~3u);
+    }
+  m_interfaces.push_back(itf);
+}
+
+bool
+PcapReader::NextPcapng (const uint8_t*& data, uint32_t& capLen, uint32_t& origLen,
+			uint32_t& linkType, int64_t& ns)
+{
+  while(m_pos + 12 <= m_size)
+    {
+      const uint8_t* block = m_data + m_pos;
+      uint32_t       type  = ReadBE32(block);
+      if(type == PCAPNG_SHB)
+	{
+	  //A new section, its byte order and interfaces
+	  m_bigEndian = (ReadBE32(block + 8) == PCAPNG_BOM);
+	  m_interfaces.clear();
+	}
+      else
+	{
+	  type = Read32(block);
+	}
+
+      uint32_t blockLen = Read32(block + 4);
+      if(blockLen < 12 || m_pos + blockLen > m_size)
+	{
+	  NS_LOG_WARN("pcapng file is truncated");
+	  return false;
+	}
+      m_pos += blockLen;
+
+      const uint8_t* body    = block + 8;
+      uint32_t       bodyLen = blockLen - 12;
+      if(type == PCAPNG_IDB && bodyLen >= 8)
+	{
+	  AddInterface(body, bodyLen);
+	}
+      else if((type == PCAPNG_EPB || type == PCAPNG_PB) && bodyLen >= 20)
+	{
+	  uint32_t itf = (type == PCAPNG_EPB) ? Read32(body) : Read16(body);
+	  if(itf >= m_interfaces.size())
+	    {
+	      NS_LOG_WARN("pcapng packet of an unknown interface");
+	      continue;
+	    }
+	  uint64_t ts = (uint64_t)Read32(body + 4) << 32 | Read32(body + 8);
+	  capLen  = Read32(body + 12);
+	  origLen = Read32(body + 16);
+	  if(capLen > bodyLen - 20)
+	    {
+	      NS_LOG_WARN("pcapng packet is longer than its block");
+	      continue;
+	    }
+	  data     = body + 20;
+	  linkType = m_interfaces[itf].linkType;
+	  ns       = TimestampNs(ts, m_interfaces[itf].tsResol);
+	  return true;
+	}
+      //Other blocks(simple packet without time, statistics, name resolution...) are skipped
+    }
+  return false;
+}
+
+bool
+PcapReader::ParseFrame (const uint8_t* data, uint32_t capLen, uint32_t origLen,
+			uint32_t linkType, TraceRecord_t& record)
+{
+  //1. Link layer
+  uint32_t off = 0;
+  uint16_t etherType;
+  if(linkType == LINKTYPE_ETHERNET)
+    {
+      off = 12;
+      if(off + 2 > capLen) return false;
+      etherType = ReadBE16(data + off);
+      while(etherType == ETHERTYPE_VLAN || etherType == ETHERTYPE_QINQ)
+	{
+	  off += 4;
+	  if(off + 2 > capLen) return false;
+	  etherType = ReadBE16(data + off);
+	}
+      off += 2;
+    }
+  else if(linkType == LINKTYPE_LINUX_SLL)
+    {
+      if(16 > capLen) return false;
+      etherType = ReadBE16(data + 14);
+      off = 16;
+    }
+  else if(linkType == LINKTYPE_LINUX_SLL2)
+    {
+      if(20 > capLen) return false;
+      etherType = ReadBE16(data);
+      off = 20;
+    }
+  else if(linkType == LINKTYPE_RAW || linkType == LINKTYPE_IPV4)
+    {
+      etherType = ETHERTYPE_IPV4;
+    }
+  else
+    {
+      return false;
+    }
+  if(etherType != ETHERTYPE_IPV4)
+    return false;
+
+  //2. IPv4, the non first fragments have no ports
+  const uint8_t* ip = data + off;
+  if(off + 20 > capLen || (ip[0] >> 4) != 4)
+    return false;
+  uint32_t ihl = (ip[0] & 0x0f) * 4;
+  if((ReadBE16(ip + 6) & 0x1fff) != 0)
+    return false;
+
+  if(ip[9] == TcpL4Protocol::PROT_NUMBER)
+    record.type = TcpL4Protocol::PROT_NUMBER;
+  else if(ip[9] == UdpL4Protocol::PROT_NUMBER)
+    record.type = UdpL4Protocol::PROT_NUMBER;
+  else
+    return false;
+
+  //3. Ports
+  if(off + ihl + 4 > capLen)
+    return false;
+  record.ipsrc   = ReadBE32(ip + 12);
+  record.ipdst   = ReadBE32(ip + 16);
+  record.portsrc = ReadBE16(ip + ihl);
+  record.portdst = ReadBE16(ip + ihl + 2);
+
+  //The total length is 0 if the capture is taken before TSO, use the wire length
+  uint32_t ipBytes = ReadBE16(ip + 2);
+  if(ipBytes == 0)
+    ipBytes = origLen > off ? origLen - off : 0;
+  record.size = TracePayloadSize(ipBytes, record.type == TcpL4Protocol::PROT_NUMBER);
+  return true;
+}
+
+bool
+PcapReader::Next (TraceRecord_t& record)
+{
+  const uint8_t* data;
+  uint32_t       capLen, origLen, linkType;
+  int64_t        ns;
+  while(m_pcapng ? NextPcapng(data, capLen, origLen, linkType, ns)
+	         : NextPcap(data, capLen, origLen, linkType, ns))
+    {
+      if(!ParseFrame(data, capLen, origLen, linkType, record))
+	continue;
+
+      if(!m_started)
+	{
+	  m_started = true;
+	  m_firstNs = ns;
+	}
+      record.time = (ns - m_firstNs) * 1e-9;
+      return true;
+    }
+  return false;
+}
+
+}
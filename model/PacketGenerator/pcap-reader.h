@@ -0,0 +1,75 @@
+
+#ifndef PCAP_READER_H
+#define PCAP_READER_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "trace-record.h"
+
+namespace ns3{
+
+/* Streams the IPv4 TCP UDP packets of a pcap or pcapng capture in place,
+ * the capture is mapped by the TraceReader, nothing is copied.
+ * The link types are Ethernet(with VLAN tags), Linux cooked(SLL, SLL2) and raw IPv4.
+ * The times are from the first packet, the sizes are from the packets' ip total
+ * lengths(TracePayloadSize), not the captured lengths.
+ */
+class PcapReader
+{
+public:
+  PcapReader ();
+
+  /* Is the data a pcap or pcapng capture
+   */
+  static bool IsPcap (const uint8_t* data, size_t size);
+
+  void Open (const uint8_t* data, size_t size);
+
+  /* The next packet, false at the end of the capture
+   */
+  bool Next (TraceRecord_t& record);
+
+private:
+  struct Interface_t
+  {
+    uint32_t linkType;
+    uint32_t tsResol;   //if_tsresol, 10^-v or 2^-v(MSB set) seconds
+  };
+
+  uint16_t Read16 (const uint8_t* p) const;
+  uint32_t Read32 (const uint8_t* p) const;
+
+  /* The next packet of the pcap or pcapng file, data is the link layer frame
+   */
+  bool NextPcap (const uint8_t*& data, uint32_t& capLen, uint32_t& origLen,
+		 uint32_t& linkType, int64_t& ns);
+  bool NextPcapng (const uint8_t*& data, uint32_t& capLen, uint32_t& origLen,
+		   uint32_t& linkType, int64_t& ns);
+
+  /* Parse the interface description block's options
+   */
+  void AddInterface (const uint8_t* body, uint32_t bodyLen);
+
+  /* Parse the frame into the record, false if it is not an IPv4 TCP UDP packet
+   */
+  static bool ParseFrame (const uint8_t* data, uint32_t capLen, uint32_t origLen,
+			  uint32_t linkType, TraceRecord_t& record);
+
+  static int64_t TimestampNs (uint64_t ts, uint32_t tsResol);
+
+  const uint8_t*            m_data;
+  size_t                    m_size;
+  size_t                    m_pos;
+  bool                      m_pcapng;
+  bool                      m_bigEndian;     //byte order of the file(or the pcapng section)
+  bool                      m_nanoSecond;    //pcap time resolution
+  uint32_t                  m_linkType;      //pcap link type
+  std::vector<Interface_t>  m_interfaces;    //pcapng interfaces of the section
+  bool                      m_started;
+  int64_t                   m_firstNs;       //time of the first packet
+};
+
+}
+
+#endif
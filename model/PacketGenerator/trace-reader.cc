@@ -0,0 +1,431 @@
+
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cfloat>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ns3/log.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/udp-l4-protocol.h"
+#include "ns3/tcp-l4-protocol.h"
+#include "ns3/system-thread.h"
+
+#include "trace-reader.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("TraceReader");
+
+const size_t TraceReader::BATCH_SIZE;
+const char   TraceReader::TRACE_MAGIC[8] = {'D', 'C', 'T', 'R', 'A', 'C', 'E', '1'};
+
+/* Ring wait timeout. The conditions are set under m_ringMutex with the ring change
+ * then signalled, so a waiter is woken at once; SystemCondition::TimedWait clears
+ * the condition on entry, so the timeout only bounds a signal lost between the
+ * ring check and the wait.
+ */
+static const uint64_t RING_WAIT_NS = 1000000;
+
+TraceReader::TraceReader(const char* filename, float endTime, bool prefetch, size_t ringSize)
+  : m_endTime(endTime), m_prefetch(prefetch),
+    m_format(TEXT_TRACE), m_map(NULL), m_mapSize(0), m_header(NULL), m_pos(0),
+    m_timeCur(NULL), m_timeEnd(NULL), m_timeNs(0),
+    m_mask(0), m_head(0), m_tail(0), m_eof(false), m_stop(false), m_batchPos(0)
+{
+  NS_LOG_FUNCTION(filename << endTime << prefetch);
+
+  m_file.open (filename, std::ios::binary);
+  if(m_file.fail())
+    NS_FATAL_ERROR("packet file can not open");
+
+  char magic[sizeof(TRACE_MAGIC)];
+  if(m_file.read(magic, sizeof(magic)))
+    {
+      if(std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0)
+	m_format = BINARY_TRACE;
+      else if(PcapReader::IsPcap((const uint8_t*)magic, sizeof(magic)))
+	m_format = PCAP_TRACE;
+    }
+
+  if(m_format != TEXT_TRACE)
+    {
+      m_file.close();
+      MapFile(filename);
+      if(m_format == BINARY_TRACE)
+	OpenBinary();
+      else
+	m_pcap.Open(m_map, m_mapSize);
+      m_prefetch = false;
+      return;
+    }
+
+  m_file.clear();
+  m_file.seekg(0);
+  std::string line;
+  std::getline(m_file, line); //Read out the table header.
+
+  if(m_prefetch)
+    {
+      size_t capacity = BATCH_SIZE;
+      while(capacity < ringSize)
+	{
+	  capacity <<= 1;
+	}
+      m_ring.resize(capacity);
+      m_mask = capacity - 1;
+      m_batch.reserve(BATCH_SIZE);
+
+      m_thread = Create<SystemThread>( MakeCallback(&TraceReader::PrefetchThread, this) );
+      m_thread->Start();
+    }
+}
+
+TraceReader::~TraceReader()
+{
+  if(m_map)
+    {
+      munmap((void*)m_map, m_mapSize);
+    }
+
+  if(m_thread)
+    {
+      {
+	CriticalSection cs(m_ringMutex);
+	m_stop = true;
+	m_notFull.SetCondition(true);
+      }
+      m_notFull.Signal();
+      m_thread->Join();
+    }
+}
+
+void
+TraceReader::MapFile(const char* filename)
+{
+  int fd = open(filename, O_RDONLY);
+  if(fd < 0)
+    NS_FATAL_ERROR("packet file can not open");
+  struct stat st;
+  if(fstat(fd, &st) != 0)
+    NS_FATAL_ERROR("packet file can not stat");
+
+  m_mapSize = st.st_size;
+  void* map = mmap(NULL, m_mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED)
+    NS_FATAL_ERROR("packet file can not mmap");
+  madvise(map, m_mapSize, MADV_SEQUENTIAL);
+  m_map = (const uint8_t*)map;
+}
+
+void
+TraceReader::OpenBinary()
+{
+  if(m_mapSize < sizeof(TraceFileHeader_t))
+    NS_FATAL_ERROR("binary packet file is truncated");
+  m_header = (const TraceFileHeader_t*)m_map;
+
+  uint64_t n = m_header->numRecords;
+  if(m_header->ipsrcOffset   + 4 * n > m_mapSize ||
+     m_header->ipdstOffset   + 4 * n > m_mapSize ||
+     m_header->portsrcOffset + 2 * n > m_mapSize ||
+     m_header->portdstOffset + 2 * n > m_mapSize ||
+     m_header->sizeOffset    + 2 * n > m_mapSize ||
+     m_header->typeOffset    + n     > m_mapSize ||
+     m_header->timeOffset + m_header->timeBytes > m_mapSize)
+    NS_FATAL_ERROR("binary packet file is truncated");
+
+  m_timeCur = m_map + m_header->timeOffset;
+  m_timeEnd = m_timeCur + m_header->timeBytes;
+  NS_LOG_INFO("Binary packet trace of " << n << " packets");
+}
+
+bool
+TraceReader::Parse(TraceRecord_t& record)
+{
+  switch(m_format)
+    {
+    case BINARY_TRACE:
+      return DecodeBinary(record);
+    case PCAP_TRACE:
+      if(!m_pcap.Next(record) || record.time > m_endTime)
+	return false;
+      return true;
+    default:
+      return ParseText(record);
+    }
+}
+
+bool
+TraceReader::DecodeBinary(TraceRecord_t& record)
+{
+  if(m_pos == m_header->numRecords)
+    return false;
+
+  //zigzag varint delta
+  uint64_t zz    = 0;
+  unsigned shift = 0;
+  uint8_t  byte;
+  do
+    {
+      if(m_timeCur == m_timeEnd)
+	NS_FATAL_ERROR("binary packet file time column is truncated");
+      byte   = *m_timeCur++;
+      zz    |= (uint64_t)(byte & 0x7f) << shift;
+      shift += 7;
+    }
+  while(byte & 0x80);
+  m_timeNs += (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+
+  record.time = m_timeNs * 1e-9;
+  if(record.time > m_endTime) //The rest of the trace is not replayed
+    return false;
+
+  uint64_t i = m_pos++;
+  record.ipsrc   = ((const uint32_t*)(m_map + m_header->ipsrcOffset))[i];
+  record.ipdst   = ((const uint32_t*)(m_map + m_header->ipdstOffset))[i];
+  record.portsrc = ((const uint16_t*)(m_map + m_header->portsrcOffset))[i];
+  record.portdst = ((const uint16_t*)(m_map + m_header->portdstOffset))[i];
+  record.size    = ((const uint16_t*)(m_map + m_header->sizeOffset))[i];
+  record.type    = m_map[m_header->typeOffset + i];
+  return true;
+}
+
+bool
+TraceReader::ParseText(TraceRecord_t& record)
+{
+  std::string line;
+  while(std::getline(m_file, line))
+    {
+      m_line.clear();
+      m_line.str(line);
+
+      unsigned    packetID;
+      std::string ipsrc, ipdst;
+      std::string l4prot;
+      std::string trash; //for escaping the content
+
+      m_line >> packetID >> record.time;
+      if(record.time > m_endTime) //The rest of the trace is not replayed
+	return false;
+
+      m_line >> ipsrc >> ipdst >> l4prot;
+      if(l4prot == "TCP")
+	record.type = TcpL4Protocol::PROT_NUMBER;
+      else if(l4prot == "UDP")
+	record.type = UdpL4Protocol::PROT_NUMBER;
+      else
+	continue;
+
+      //The Length is the ethernet frame
+      uint32_t frameBytes;
+      m_line >> frameBytes >> record.portsrc >> trash >> record.portdst;
+      record.size = TracePayloadSize(frameBytes > TRACE_ETHER_HEADER ? frameBytes - TRACE_ETHER_HEADER : 0,
+				     record.type == TcpL4Protocol::PROT_NUMBER);
+
+      record.ipsrc = Ipv4Address(ipsrc.c_str()).Get();
+      record.ipdst = (ipdst == "Broadcast") ? Ipv4Address::GetBroadcast().Get()
+	                                    : Ipv4Address(ipdst.c_str()).Get();
+      return true;
+    }
+  return false;
+}
+
+void
+TraceReader::PrefetchThread()
+{
+  TraceRecord_t record;
+  bool          more = Parse(record);
+  while(more)
+    {
+      {
+	CriticalSection cs(m_ringMutex);
+	if(m_stop)
+	  return;
+	if(m_tail - m_head <= m_mask)
+	  {
+	    m_ring[m_tail & m_mask] = record;
+	    ++m_tail;
+	    more = false;
+	    m_notEmpty.SetCondition(true);
+	  }
+      }
+
+      if(!more)
+	{
+	  //pushed, parse the next one
+	  m_notEmpty.Signal();
+	  more = Parse(record);
+	}
+      else
+	{
+	  m_notFull.TimedWait(RING_WAIT_NS);
+	  m_notFull.SetCondition(false);
+	}
+    }
+
+  {
+    CriticalSection cs(m_ringMutex);
+    m_eof = true;
+    m_notEmpty.SetCondition(true);
+  }
+  m_notEmpty.Signal();
+}
+
+bool
+TraceReader::FetchBatch()
+{
+  m_batch.clear();
+  m_batchPos = 0;
+  while(true)
+    {
+      bool eof;
+      {
+	CriticalSection cs(m_ringMutex);
+	while(m_head != m_tail && m_batch.size() < BATCH_SIZE)
+	  {
+	    m_batch.push_back(m_ring[m_head & m_mask]);
+	    ++m_head;
+	  }
+	if(!m_batch.empty())
+	  m_notFull.SetCondition(true);
+	eof = m_eof;
+      }
+
+      if(!m_batch.empty())
+	{
+	  m_notFull.Signal();
+	  return true;
+	}
+      if(eof)
+	return false;
+
+      m_notEmpty.TimedWait(RING_WAIT_NS);
+      m_notEmpty.SetCondition(false);
+    }
+}
+
+bool
+TraceReader::Next(TraceRecord_t& record)
+{
+  if(!m_prefetch)
+    return Parse(record);
+
+  if(m_batchPos == m_batch.size() && !FetchBatch())
+    return false;
+  record = m_batch[m_batchPos++];
+  return true;
+}
+
+/* Append the column file to the binary trace at an 8 bytes aligned offset, return the offset
+ */
+static uint64_t
+AppendColumn(std::FILE* out, const std::string& colFile)
+{
+  static const char pad[8] = {0};
+  long pos = std::ftell(out);
+  std::fwrite(pad, 1, (8 - pos % 8) % 8, out);
+  uint64_t offset = std::ftell(out);
+
+  std::FILE* in = std::fopen(colFile.c_str(), "rb");
+  if(!in)
+    NS_FATAL_ERROR("trace column file can not open");
+  char   buf[1 << 16];
+  size_t n;
+  while((n = std::fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+      std::fwrite(buf, 1, n, out);
+    }
+  std::fclose(in);
+  std::remove(colFile.c_str());
+  return offset;
+}
+
+void
+TraceReader::ConvertTextTrace(const char* textFile, const char* binFile)
+{
+  NS_LOG_FUNCTION(textFile << binFile);
+
+  enum { IPSRC, IPDST, PORTSRC, PORTDST, SIZE, TYPE, TIME, NUM_COLUMN };
+  std::string colFiles[NUM_COLUMN];
+  std::FILE*  cols[NUM_COLUMN];
+  for(int c = 0; c < NUM_COLUMN; ++c)
+    {
+      std::ostringstream oss;
+      oss << binFile << ".col" << c;
+      colFiles[c] = oss.str();
+      cols[c]     = std::fopen(colFiles[c].c_str(), "wb");
+      if(!cols[c])
+	NS_FATAL_ERROR("trace column file can not open");
+    }
+
+  TraceReader   reader(textFile, FLT_MAX, false);
+  TraceRecord_t record;
+  uint64_t      numRecords = 0;
+  uint64_t      timeBytes  = 0;
+  int64_t       lastNs     = 0;
+  while(reader.Next(record))
+    {
+      uint16_t size = record.size;  //at most the mtu
+      std::fwrite(&record.ipsrc,   4, 1, cols[IPSRC]);
+      std::fwrite(&record.ipdst,   4, 1, cols[IPDST]);
+      std::fwrite(&record.portsrc, 2, 1, cols[PORTSRC]);
+      std::fwrite(&record.portdst, 2, 1, cols[PORTDST]);
+      std::fwrite(&size,           2, 1, cols[SIZE]);
+      std::fwrite(&record.type,    1, 1, cols[TYPE]);
+
+      int64_t  ns    = (int64_t)(record.time * 1e9 + 0.5);
+      int64_t  delta = ns - lastNs;
+      uint64_t zz    = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+      lastNs = ns;
+      do
+	{
+	  uint8_t byte = zz & 0x7f;
+	  zz >>= 7;
+	  if(zz)
+	    byte |= 0x80;
+	  std::fputc(byte, cols[TIME]);
+	  ++timeBytes;
+	}
+      while(zz);
+      ++numRecords;
+    }
+
+  for(int c = 0; c < NUM_COLUMN; ++c)
+    {
+      std::fclose(cols[c]);
+    }
+
+  std::FILE* out = std::fopen(binFile, "wb");
+  if(!out)
+    NS_FATAL_ERROR("binary packet file can not open");
+
+  TraceFileHeader_t header;
+  std::memset(&header, 0, sizeof(header));
+  std::fwrite(&header, sizeof(header), 1, out);
+
+  std::memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  header.numRecords    = numRecords;
+  header.ipsrcOffset   = AppendColumn(out, colFiles[IPSRC]);
+  header.ipdstOffset   = AppendColumn(out, colFiles[IPDST]);
+  header.portsrcOffset = AppendColumn(out, colFiles[PORTSRC]);
+  header.portdstOffset = AppendColumn(out, colFiles[PORTDST]);
+  header.sizeOffset    = AppendColumn(out, colFiles[SIZE]);
+  header.typeOffset    = AppendColumn(out, colFiles[TYPE]);
+  header.timeOffset    = AppendColumn(out, colFiles[TIME]);
+  header.timeBytes     = timeBytes;
+
+  //The magic is written last, a broken conversion is not taken as a binary trace
+  std::fseek(out, 0, SEEK_SET);
+  std::fwrite(&header, sizeof(header), 1, out);
+  std::fclose(out);
+
+  NS_LOG_INFO("Converted " << numRecords << " packets into " << binFile);
+}
+
+}
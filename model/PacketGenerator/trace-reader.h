@@ -0,0 +1,127 @@
+
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include "ns3/object.h"
+#include "ns3/system-mutex.h"
+#include "ns3/system-condition.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "trace-record.h"
+#include "pcap-reader.h"
+
+namespace ns3{
+
+class SystemThread;
+
+/* Header of the binary columnar trace, the columns follow it(8 bytes aligned):
+ * ipsrc u32[n], ipdst u32[n], portsrc u16[n], portdst u16[n], size u16[n], type u8[n],
+ * time: the zigzag varint deltas of the times in ns.
+ */
+struct TraceFileHeader_t
+{
+  char     magic[8];       //TRACE_MAGIC
+  uint64_t numRecords;
+  uint64_t ipsrcOffset;
+  uint64_t ipdstOffset;
+  uint64_t portsrcOffset;
+  uint64_t portdstOffset;
+  uint64_t sizeOffset;
+  uint64_t typeOffset;
+  uint64_t timeOffset;
+  uint64_t timeBytes;
+};
+
+/* The packet trace is parsed once here and shared by all the hosts' PacketGenerators.
+ * Only the TCP and UDP packets before endTime are returned.
+ * The text trace is parsed line by line. If prefetch, a background thread parses
+ * ahead into a bounded ring of ringSize records, the simulator thread only pops them.
+ * The binary trace(see ConvertTextTrace) and the pcap pcapng captures are mmaped
+ * and decoded in place, they need no prefetch.
+ */
+class TraceReader : public Object
+{
+public:
+  TraceReader(const char* filename, float endTime, bool prefetch, size_t ringSize = 1 << 16);
+  virtual ~TraceReader();
+
+  /* The next record, false at the end of the trace
+   */
+  bool Next(TraceRecord_t& record);
+
+  /* Convert the text trace(or capture) into the binary trace, the TCP and UDP packets are kept.
+   * The columns are spilled to temporary files next to binFile, the memory is bounded.
+   */
+  static void ConvertTextTrace(const char* textFile, const char* binFile);
+
+  static const char TRACE_MAGIC[8];
+
+private:
+  TraceReader(const TraceReader&);
+  TraceReader& operator=(const TraceReader&);
+
+  /* The next TCP UDP record of the trace, false at the end
+   */
+  bool Parse(TraceRecord_t& record);
+  bool ParseText(TraceRecord_t& record);
+  bool DecodeBinary(TraceRecord_t& record);
+
+  /* mmap the trace file
+   */
+  void MapFile(const char* filename);
+
+  /* Check the columns of the mapped binary trace
+   */
+  void OpenBinary();
+
+  /* The prefetch thread, fill the ring until the end of the trace
+   */
+  void PrefetchThread();
+
+  /* Move a batch of records from the ring to m_batch, false if the trace is done
+   */
+  bool FetchBatch();
+
+  static const size_t BATCH_SIZE = 256;  //records moved per ring lock
+
+  std::ifstream               m_file;
+  std::istringstream          m_line;    //reused for every line
+  float                       m_endTime;
+  bool                        m_prefetch;
+
+  enum TraceFormat_t { TEXT_TRACE, BINARY_TRACE, PCAP_TRACE };
+  TraceFormat_t               m_format;
+
+  //Binary trace and pcap, mmaped
+  const uint8_t*              m_map;
+  size_t                      m_mapSize;
+  const TraceFileHeader_t*    m_header;
+  uint64_t                    m_pos;       //next record
+  const uint8_t*              m_timeCur;   //next time delta
+  const uint8_t*              m_timeEnd;
+  int64_t                     m_timeNs;    //time of the last record
+  PcapReader                  m_pcap;
+
+  //Ring, m_head and m_tail count the records popped and pushed
+  std::vector<TraceRecord_t>  m_ring;
+  size_t                      m_mask;
+  size_t                      m_head;
+  size_t                      m_tail;
+  bool                        m_eof;      //the prefetch thread has pushed the last record
+  bool                        m_stop;     //the reader is destroyed, stop prefetching
+  SystemMutex                 m_ringMutex;
+  SystemCondition             m_notEmpty;
+  SystemCondition             m_notFull;
+  Ptr<SystemThread>           m_thread;
+
+  //The records popped from the ring, used by the simulator thread only
+  std::vector<TraceRecord_t>  m_batch;
+  size_t                      m_batchPos;
+};
+
+}
+
+#endif
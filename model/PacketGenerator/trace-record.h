@@ -0,0 +1,61 @@
+
+#ifndef TRACE_RECORD_H
+#define TRACE_RECORD_H
+
+#include <stdint.h>
+
+#include "ns3/flow-hash.h"
+
+namespace ns3{
+
+/* A parsed packet of the trace, the ips are the raw trace addresses.
+ */
+struct TraceRecord_t
+{
+  double   time;      //seconds from the start of the trace
+  uint32_t ipsrc;
+  uint32_t ipdst;     //0xffffffff if Broadcast
+  uint8_t  type;      //TcpL4Protocol::PROT_NUMBER or UdpL4Protocol::PROT_NUMBER
+  uint16_t portsrc;
+  uint16_t portdst;
+  uint32_t size;      //L4 payload bytes, see TracePayloadSize
+};
+
+static const uint32_t TRACE_MTU          = 1500;  //the hosts' csma mtu
+static const uint32_t TRACE_ETHER_HEADER = 14;
+static const uint32_t TRACE_IPV4_HEADER  = 20;    //the headers PacketGenerator adds
+static const uint32_t TRACE_TCP_HEADER   = 20;
+static const uint32_t TRACE_UDP_HEADER   = 8;
+
+/* The payload PacketGenerator sends for a traced ip packet of ipBytes,
+ * the packet is cut to the mtu(PacketGenerator does not fragment).
+ */
+inline uint32_t
+TracePayloadSize(uint32_t ipBytes, bool isTcp)
+{
+  uint32_t headers = TRACE_IPV4_HEADER + (isTcp ? TRACE_TCP_HEADER : TRACE_UDP_HEADER);
+  if(ipBytes > TRACE_MTU)
+    ipBytes = TRACE_MTU;
+  return ipBytes > headers ? ipBytes - headers : 0;
+}
+
+static const uint32_t TRACE_SRC_HOST_SEED = 0x51C0;
+static const uint32_t TRACE_DST_HOST_SEED = 0xD571;
+
+/* The data center host of a raw trace ip, a seeded hash of the ip. It does not depend
+ * on the order the ips are seen in, so a run restored from a checkpoint maps the ips
+ * to the hosts of the run that saved it. The ip is never mapped to exclude(-1 for none).
+ */
+inline unsigned
+TraceHost(uint32_t rawAddr, uint32_t seed, unsigned numHost, int exclude = -1)
+{
+  uint32_t h   = fmix32(rawAddr ^ seed);
+  unsigned idx = h % numHost;
+  if((int)idx == exclude && numHost > 1)
+    idx = (idx + 1 + (h / numHost) % (numHost - 1)) % numHost;
+  return idx;
+}
+
+}
+
+#endif
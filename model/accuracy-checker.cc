@@ -0,0 +1,79 @@
+#include "accuracy-checker.h"
+
+#include <algorithm>
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("AccuracyChecker");
+
+AccuracyChecker::AccuracyChecker (const std::string& filename)
+  : m_file(filename.c_str())
+{
+  NS_ASSERT( m_file.is_open() );
+  m_file << "time sw real decoded decodeRate falsePositive undetected exact "
+	 << "meanErr p50 p90 p99 maxErr" << std::endl;
+}
+
+AccuracyChecker::~AccuracyChecker ()
+{
+  m_file.close();
+}
+
+void
+AccuracyChecker::EndPeriod ()
+{
+  Output("all", m_period, 0);
+  NS_LOG_INFO("Decode rate " << m_period.GetDecodeRate()
+	      << " false positive " << m_period.m_numFalsePositive
+	      << " undetected " << m_period.m_numUndetected
+	      << " exact " << m_period.m_numExact << "/" << m_period.m_numDetected);
+
+  m_period = AccuracyStat_t();
+  m_relErrors.clear();
+}
+
+void
+AccuracyChecker::Output (const std::string& sw, const AccuracyStat_t& stat, size_t errBegin)
+{
+  std::vector<double>::iterator begin = m_relErrors.begin() + errBegin;
+  std::vector<double>::iterator end   = m_relErrors.end();
+  size_t                        n     = end - begin;
+
+  double mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+  if(n > 0)
+    {
+      for(std::vector<double>::iterator it = begin; it != end; ++it)
+	mean += *it;
+      mean /= n;
+
+      //Ascending order, the percentiles are picked in place
+      std::nth_element(begin, begin + n * 50 / 100, end); p50 = *(begin + n * 50 / 100);
+      std::nth_element(begin, begin + n * 90 / 100, end); p90 = *(begin + n * 90 / 100);
+      std::nth_element(begin, begin + n * 99 / 100, end); p99 = *(begin + n * 99 / 100);
+      max = *std::max_element(begin, end);
+    }
+
+  m_file << Simulator::Now().GetSeconds() << " " << sw << " "
+	 << stat.m_numReal << " " << stat.m_numDecoded << " "
+	 << stat.GetDecodeRate() << " " << stat.m_numFalsePositive << " "
+	 << stat.m_numUndetected << " " << stat.m_numExact << " "
+	 << mean << " " << p50 << " " << p90 << " " << p99 << " " << max << std::endl;
+}
+
+void
+AccuracyChecker::Accumulate (AccuracyStat_t& total, const AccuracyStat_t& stat)
+{
+  total.m_numReal          += stat.m_numReal;
+  total.m_numDecoded       += stat.m_numDecoded;
+  total.m_numDetected      += stat.m_numDetected;
+  total.m_numExact         += stat.m_numExact;
+  total.m_numFalsePositive += stat.m_numFalsePositive;
+  total.m_numUndetected    += stat.m_numUndetected;
+}
+
+}
@@ -0,0 +1,113 @@
+#ifndef ACCURACY_CHECKER_H
+#define ACCURACY_CHECKER_H
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "flow-field.h"
+
+namespace ns3
+{
+
+/* The accuracy of the decoded flows of a switch(or of all switches) in a period
+ */
+struct AccuracyStat_t
+{
+  AccuracyStat_t() : m_numReal(0), m_numDecoded(0), m_numDetected(0), m_numExact(0),
+		     m_numFalsePositive(0), m_numUndetected(0)
+  {}
+
+  /* Detected real flows / real flows
+   */
+  double GetDecodeRate() const
+  {
+    return m_numReal ? (double)m_numDetected / m_numReal : 1.0;
+  }
+
+  uint32_t m_numReal;           //flows measured at the encoder
+  uint32_t m_numDecoded;        //flows output by the decoder
+  uint32_t m_numDetected;       //decoded flows that are real
+  uint32_t m_numExact;          //detected flows with the exact packet cnt
+  uint32_t m_numFalsePositive;  //decoded flows that are not real
+  uint32_t m_numUndetected;     //real flows not decoded
+};
+
+/* Compares the decoded flows with the encoders' real flows(GetRealFlowCounter) in
+ * memory, what check-flow.py does with the -real-flow.txt and decoded flow files.
+ * Check the switches of a period then EndPeriod, a line is saved per switch and
+ * per period:
+ * time sw real decoded decodeRate falsePositive undetected exact meanErr p50 p90 p99 maxErr
+ * The errors are the detected flows' packet cnt relative errors |decoded - real| / real,
+ * sw is "all" for the period.
+ */
+class AccuracyChecker
+{
+public:
+  AccuracyChecker (const std::string& filename);
+  ~AccuracyChecker ();
+
+  /* REAL is a FlowField keyed map, DECODED is a container of (FlowField, cnt) pairs,
+   * the cnts are packet cnts or PckByteCnt.
+   */
+  template<class REAL, class DECODED>
+  void Check (int swID, const REAL& real, const DECODED& decoded);
+
+  /* Save the aggregate of the switches checked since the last period
+   */
+  void EndPeriod ();
+
+private:
+  AccuracyChecker(const AccuracyChecker&);
+  AccuracyChecker& operator=(const AccuracyChecker&);
+
+  /* Save the stat and the relative errors from errBegin, the errors are reordered
+   */
+  void Output (const std::string& sw, const AccuracyStat_t& stat, size_t errBegin);
+
+  static void Accumulate (AccuracyStat_t& total, const AccuracyStat_t& stat);
+
+  std::ofstream        m_file;
+  AccuracyStat_t       m_period;      //all switches of the period
+  std::vector<double>  m_relErrors;   //detected flows' errors of the period
+};
+
+template<class REAL, class DECODED>
+void
+AccuracyChecker::Check (int swID, const REAL& real, const DECODED& decoded)
+{
+  AccuracyStat_t stat;
+  size_t         errBegin = m_relErrors.size();
+
+  stat.m_numReal    = real.size();
+  stat.m_numDecoded = decoded.size();
+  for(typename DECODED::const_iterator it = decoded.begin(); it != decoded.end(); ++it)
+    {
+      typename REAL::const_iterator itReal = real.find(it->first);
+      if(itReal == real.end())
+	{
+	  ++stat.m_numFalsePositive;
+	  continue;
+	}
+
+      ++stat.m_numDetected;
+      double realCnt    = FlowPacketCnt(itReal->second);
+      double decodedCnt = FlowPacketCnt(it->second);
+      double err        = realCnt > 0 ? std::abs(decodedCnt - realCnt) / realCnt : 0.0;
+      if(err == 0.0)
+	++stat.m_numExact;
+      m_relErrors.push_back(err);
+    }
+  stat.m_numUndetected = stat.m_numReal - stat.m_numDetected;
+
+  std::stringstream ss;
+  ss << swID;
+  Output(ss.str(), stat, errBegin);
+  Accumulate(m_period, stat);
+}
+
+}
+
+#endif
@@ -14,6 +14,7 @@
 
 #include "ns3/applications-module.h"
 #include "ns3/log.h"
+#include "ns3/simulator.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/string.h"
 
@@ -22,7 +23,7 @@ NS_LOG_COMPONENT_DEFINE("AppGen");
 
 namespace ns3{
 
-  AppGen::AppGen(Ptr<DCTopology> topo) : m_topo(topo), m_flowNotGeneratedCnt(0)
+  AppGen::AppGen(Ptr<DCTopology> topo) : m_topo(topo), m_traceBurst(1), m_traceStartTime(0.f), m_flowNotGeneratedCnt(0)
 {
 }
 
@@ -31,8 +32,10 @@ AppGen::~AppGen()
 }
 
 void
-AppGen::SetPacketTrace(const char* filename, float endTime)
+AppGen::SetPacketTrace(const char* filename, float endTime, bool prefetch,
+		       unsigned burst, float startTime)
 {
+  NS_ASSERT(burst > 0);
   for(unsigned hostID = 0; hostID < m_topo->GetNumHost(); ++hostID)
     {
       Ptr<PacketGenerator> pg
@@ -41,11 +44,55 @@ AppGen::SetPacketTrace(const char* filename, float endTime)
 					m_topo->GetHostNode(hostID),
 					m_topo->GetHostMacAddr(hostID),
 					m_topo->GetHostIPAddr(hostID),
-					m_topo->GetAllHostIPAddr(),
-					filename);
-      pg->StartGenerator(endTime);
+					m_topo->GetAllHostIPAddr());
       m_packetGenerators.push_back(pg);
     }
+
+  m_traceReader = CreateObject<TraceReader>(filename, endTime, prefetch);
+  m_traceBurst     = burst;
+  m_traceStartTime = startTime;
+  ScheduleTraceBurst();
+}
+
+void
+AppGen::ScheduleTraceBurst()
+{
+  //If no more packet, just return to stop.
+  double        now = Simulator::Now().GetSeconds();
+  TraceRecord_t record;
+  for(unsigned i = 0; i < m_traceBurst; ++i)
+    {
+      bool hasNext;
+      //Skipped, the hosts are hashed from the ips(TraceHost), so the later packets
+      //are sent between the hosts of a run from 0
+      while((hasNext = m_traceReader->Next(record)) && record.time < m_traceStartTime)
+	{
+	}
+      if(!hasNext)
+	{
+	  NS_LOG_INFO("Packet trace done");
+	  return;
+	}
+
+      //The same time events run in schedule order, the trace order is kept
+      double delay = record.time - now;
+      delay = delay < 0.0 ? 0.0 : delay;
+      Simulator::Schedule (Seconds(delay), &AppGen::DispatchTrace, this, record, i + 1 == m_traceBurst);
+    }
+}
+
+void
+AppGen::DispatchTrace(TraceRecord_t record, bool lastOfBurst)
+{
+  m_packetGenerators[GetTraceSrcHost(record.ipsrc)]->SendRecord(record);
+  if(lastOfBurst)
+    ScheduleTraceBurst();
+}
+
+int
+AppGen::GetTraceSrcHost(uint32_t rawAddr)
+{
+  return TraceHost(rawAddr, TRACE_SRC_HOST_SEED, m_topo->GetNumHost());
 }
 
 
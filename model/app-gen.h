@@ -2,6 +2,7 @@
 #define APP_GEN_H
 
 #include "ns3/object.h"
+#include "PacketGenerator/trace-reader.h"
 
 namespace ns3{
 
@@ -24,9 +25,16 @@ public:
 	       float startTime, float stopTime);
   */
   
-  /* Generate packets according to the packet trace
+  /* Generate packets according to the packet trace.
+   * The trace is read once, each packet is sent by the host its src ip is mapped to.
+   * If prefetch, the trace is parsed ahead on a background thread.
+   * The trace is a text trace, a binary trace(TraceReader::ConvertTextTrace) or a capture.
+   * The sends are scheduled burst packets at a time(1 schedules the packets one by one).
+   * The packets before startTime are skipped, a run restored from a radar checkpoint
+   * (DCTopology::RestoreRadar) starts at the checkpoint time.
    */
-  void SetPacketTrace(const char* filename, float endTime);
+  void SetPacketTrace(const char* filename, float endTime, bool prefetch = true,
+		      unsigned burst = 1024, float startTime = 0.f);
 
   void GenElephantMouseFlow(int flowCnt, float bandwidth, float endTime);
   
@@ -53,9 +61,24 @@ private:
 
   int  GetDiffHostRandomly(int from);
 
+  /* Schedule the dispatch of the next m_traceBurst trace packets, each at its time
+   */
+  void ScheduleTraceBurst();
+
+  /* Send the packet from its src host, schedule the next burst if it's the last of its burst
+   */
+  void DispatchTrace(TraceRecord_t record, bool lastOfBurst);
+
+  /* The host the raw trace src ip is mapped to, see TraceHost
+   */
+  int  GetTraceSrcHost(uint32_t rawAddr);
+
   int                                 m_port;
   Ptr<DCTopology>                     m_topo;
   std::vector<Ptr<PacketGenerator> >  m_packetGenerators;
+  Ptr<TraceReader>                    m_traceReader;
+  unsigned                            m_traceBurst;
+  float                               m_traceStartTime;
   int                                 m_flowNotGeneratedCnt;
 };
 
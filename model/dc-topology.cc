@@ -2,6 +2,7 @@
 #include <fstream>
 #include <string>
 #include <limits>
+#include <cstdlib>
 
 #include "dc-topology.h"
 
@@ -16,16 +17,23 @@
 #include "ns3/arp-cache.h"
 #include "ns3/object-factory.h"
 #include "ns3/csma-net-device.h"
+#include "ns3/node-list.h"
+#include "ns3/simulator.h"
 
 #include "ns3/diff-queue.h"
 #include "ns3/queue-controller.h"
 
 #include "openflow-switch-net-device.h"
+#include "flow-field.h"
 #include "flow-encoder.h"
 #include "flow-decoder.h"
 #include "matrix-decoder.h"
 #include "matrix-encoder.h"
+#include "matrix-radar-config.h"
 #include "easy-controller.h"
+#include "flow-trace-sink.h"
+#include "radar-metrics.h"
+#include "stage-timer.h"
 
 namespace ns3 {
 
@@ -85,6 +93,11 @@ DCTopology::BuildTopo (const char* filename, TraceMode traceType,
 
   SetSWNetdeviceQueue (queueType);
 
+  if(traceType == FLOW_COUNT)
+    {
+      CreateFlowTraceSink ();
+    }
+
   Init(radarType);
   
   NS_LOG_INFO("Build Topo finished");
@@ -121,6 +134,12 @@ DCTopology::Init(MeasureMode radarType)
   m_easyController->SetTopo(Ptr<DCTopology>(this));
   m_easyController->SetDefaultFlowTable();
 
+  //The encoders' and queue controller's progress, see RadarMetrics
+  RadarMetrics::StartReporter(Seconds(METRICS_REPORT_PERIOD), "radar-metrics.txt");
+#ifdef RADAR_STAGE_TIMERS
+  Simulator::ScheduleDestroy(&StageTimers::Dump, std::string("stage-timers.txt"));
+#endif
+
   for(int ith = 0; ith < m_numHost; ++ith)
     {
       Ptr<NetDevice> dev = GetHostNetDevice(ith);
@@ -130,9 +149,15 @@ DCTopology::Init(MeasureMode radarType)
 }
 
 Graph::Path_t
-DCTopology::GetPath(int from, int to) const
+DCTopology::GetPath(int from, int to, const FlowField& flow) const
+{
+  return m_graph.GetPath(from, to, FlowFieldHash(flow, ECMP_HASH_SEED));
+}
+
+void
+DCTopology::GetNextHopPorts(int swID, int hostID, std::vector<uint16_t>& ports) const
 {
-  return m_graph.GetPath(from, to);
+  m_graph.GetNextHopPorts(swID, hostID, ports);
 }
   
 
@@ -187,10 +212,8 @@ DCTopology::GetHostNetDevice(int hostID) const
 int
 DCTopology::GetHostID(uint32_t ipv4Addr) const
 {
-  /*Hacking: Need a mapping between IP addr and Host ID
-   *Right now, we just induce the Host ID from the Ipv4Addr directly
-   */
-  return ipv4Addr & 0xff ;
+  boost::unordered_map<uint32_t, int>::const_iterator it = m_hostIDByIP.find(ipv4Addr);
+  return (it == m_hostIDByIP.end()) ? -1 : it->second;
 }
 
 Ptr<OpenFlowSwitchNetDevice>
@@ -219,6 +242,17 @@ DCTopology::AddRouteTableEntry(int swID, Ipv4Address ipDstAddr, int swOutPort)
     }
 }
 
+void
+DCTopology::RestoreRadar(const char* filename)
+{
+  if(m_flowRadar)
+    m_flowRadar->Restore(filename);
+  else if(m_matrixRadar)
+    m_matrixRadar->Restore(filename);
+  else
+    NS_FATAL_ERROR("No radar to restore");
+}
+
 
 void
 DCTopology::CreateNodes (std::ifstream& file)
@@ -298,7 +332,7 @@ DCTopology::CreateNetDevices (std::ifstream& file, TraceMode traceType)
       
     }
 
-  m_graph.SetAdjList(adjList);
+  m_graph.SetAdjList(adjList, m_numHost);
 
   if(traceType == PCAP)
     {
@@ -311,6 +345,8 @@ DCTopology::CreateNetDevices (std::ifstream& file, TraceMode traceType)
       csma.EnableAsciiAll(ascii.CreateFileStream("packet.tr"));
       NS_LOG_INFO("Trace Mode: ascii");
     }
+  else if(traceType == FLOW_COUNT)
+    NS_LOG_INFO("Trace Mode: flow count");
   else
     NS_LOG_INFO("No trace");
    
@@ -329,6 +365,9 @@ DCTopology::CreateOFSwitches ()
       m_OFSwtchDevices.Add (ofSwtch.Install (m_switchNodes.Get(idSW),
 					     m_switchPortDevices[idSW],
 					     m_easyController ));
+      //Charge the buffered packets to the switch's id in topo, as the encoders
+      DynamicCast<OpenFlowSwitchNetDevice, NetDevice> (m_OFSwtchDevices.Get(idSW))
+	->SetMemAccountOwner(idSW + m_numHost);
       
       NS_LOG_LOGIC ( "OFSW"<< idSW <<" MacAddr: "<<
 		     m_OFSwtchDevices.Get(idSW)->GetAddress() << " Port: " <<
@@ -379,13 +418,24 @@ DCTopology::SetIPAddrAndArp()
   internetstack.Install (m_hostNodes);
   internetstack.Install (m_switchNodes);
   
+  /*One /16 subnet for all hosts and switches, so there is room for
+   *thousands of hosts. Start from 10.1.1.1, same as the old /24.
+   */
   Ipv4AddressHelper ipv4;
-  ipv4.SetBase("10.1.1.0", "255.255.255.0");
+  ipv4.SetBase("10.1.0.0", "255.255.0.0", "0.0.1.1");
 
   /*Set IP Addresses*/
   m_hostIPInterface    = ipv4.Assign(m_hostDevices);
   m_OFSwtchIPInterface = ipv4.Assign(m_OFSwtchDevices);
 
+  /*Index the hosts by ip addr*/
+  m_hostIDByIP.clear();
+  m_hostIDByIP.rehash(m_numHost);
+  for(int id = 0; id < m_numHost; ++id)
+    {
+      m_hostIDByIP[GetHostIPAddr(id).Get()] = id;
+    }
+
   
   for(int id_local = 0; id_local < m_numHost; ++id_local)
     {
@@ -435,8 +485,11 @@ DCTopology::SetSWNetdeviceQueue (QueueMode queueType)
       queueFactory.SetTypeId ("ns3::DiffQueue");
       queueFactory.Set("MiceMaxPackets", UintegerValue(100));
       queueFactory.Set("ElephantMaxPackets", UintegerValue(50));
+      queueFactory.Set("MiceMaxBytes", UintegerValue(100 * 1514));
+      queueFactory.Set("ElephantMaxBytes", UintegerValue(50 * 1514));
       //queueFactory.Set("MaxPackets", UintegerValue(MAX_INT));
       queueFactory.Set("MaxPackets", UintegerValue(150)); //
+      queueFactory.Set("MaxBytes", UintegerValue(150 * 1514)); //the classes share it, the base queue counts packets
 
       for(unsigned isw = 0; isw < m_switchPortDevices.size(); ++isw)
 	{
@@ -463,13 +516,39 @@ DCTopology::SetSWNetdeviceQueue (QueueMode queueType)
       
       //Set the matrix decoder call back
       m_matrixRadar->SetDecodedCallback(MakeCallback(&QueueController::ReceiveDecodedFlow, m_queueController));
+
+      //React to the bursts between the decode periods
+      m_queueController->StartTelemetry(Seconds(MTX_TELEMETRY_PERIOD), Seconds(MTX_END_TIME));
     }  
 }
   
+void
+DCTopology::CreateFlowTraceSink ()
+{
+  NS_LOG_FUNCTION(this);
+
+  m_flowTraceSink = CreateObject<FlowTraceSink>(NodeList::GetNNodes());
+  for(NetDeviceContainer::Iterator it = m_hostDevices.Begin(); it != m_hostDevices.End(); ++it)
+    {
+      m_flowTraceSink->Install(DynamicCast<CsmaNetDevice>(*it));
+    }
+  for(unsigned isw = 0; isw < m_switchPortDevices.size(); ++isw)
+    {
+      NetDeviceContainer& swDevices = m_switchPortDevices[isw];
+      for(NetDeviceContainer::Iterator it = swDevices.Begin(); it != swDevices.End(); ++it)
+	{
+	  m_flowTraceSink->Install(DynamicCast<CsmaNetDevice>(*it));
+	}
+    }
+
+  Simulator::ScheduleDestroy(&FlowTraceSink::Output, m_flowTraceSink);
+}
+  
 DCTopology::DCTopology(const char* filename, TraceMode traceType,
 		       MeasureMode radarType, QueueMode queueType)
 {
   NS_LOG_FUNCTION (this);
+  std::srand(0x2BAD);  //ensure same random seeds in each simulation
   BuildTopo(filename, traceType, radarType, queueType);
 }
 
@@ -9,6 +9,8 @@
 #include <iosfwd>
 #include <vector>
 
+#include <boost/unordered_map.hpp>
+
 #include "ns3/object.h"
 #include "ns3/node-container.h"
 #include "ns3/net-device-container.h"
@@ -22,6 +24,7 @@ enum TraceMode
 {
   PCAP,
   ASCII,
+  FLOW_COUNT,   //the in simulator FlowTraceSink instead of the ascii trace
   NOTRACE
 };
 
@@ -40,12 +43,14 @@ enum QueueMode
 
 class FlowDecoder;
 class MatrixDecoder;
+struct FlowField;
 namespace ofi
 { 
   class EasyController;
 }
 class OpenFlowSwitchNetDevice;
 class QueueController;
+class FlowTraceSink;
   
 class DCTopology : public Object {
   
@@ -68,7 +73,14 @@ public:
   void BuildTopo (const char* filename, TraceMode traceType,
 		  MeasureMode radarType, QueueMode queueType);
 
-  Graph::Path_t                GetPath    (int from, int to) const;
+  /* The ECMP path of the flow from host from to host to, the controller's
+   * forwarding rules and the decoders must use this same path.
+   */
+  Graph::Path_t                GetPath    (int from, int to, const FlowField& flow) const;
+  /* The ports of the switch's ECMP next hop group to the host
+   */
+  void                         GetNextHopPorts (int swID, int hostID,
+						std::vector<uint16_t>& ports) const;
   unsigned                     GetNumHost () const;
   unsigned                     GetNumSW   () const;
   Ipv4Address                  GetHostIPAddr    (int hostID) const;
@@ -76,14 +88,24 @@ public:
   Address                      GetHostMacAddr   (int hostID) const;
   Ptr<Node>                    GetHostNode      (int hostID) const;
   Ptr<NetDevice>               GetHostNetDevice (int hostID) const;
-  //TODO: GetHostID need a more concrete version.
+  /* Host ID of the host ip address(host order), -1 if it's not a host's.
+   */
   int                          GetHostID  (uint32_t ipv4Addr) const; 
   Ptr<OpenFlowSwitchNetDevice> GetOFSwtch (int SWID) const;
   Ptr<Node>                    GetSWNode  (int SWID) const;
 
+  /* The ground truth flow counts of the FLOW_COUNT trace mode, NULL in other modes
+   */
+  Ptr<FlowTraceSink>           GetFlowTraceSink () const { return m_flowTraceSink;}
+
   //Add the route table entry to the QueueController
   void                         AddRouteTableEntry(int swID, Ipv4Address ipDstAddr, int swOutPort);
 
+  /* Restore the radar's encoders from a checkpoint of a run of the same topology,
+   * the decoding resumes at the checkpoint time(see AppGen::SetPacketTrace startTime).
+   */
+  void                         RestoreRadar(const char* filename);
+
 private:
   DCTopology(const DCTopology&);
   DCTopology& operator=(const DCTopology&);
@@ -140,11 +162,17 @@ private:
    * Initialize all queues and queue controller, and register the queues to the queue controller
    */
   void SetSWNetdeviceQueue (QueueMode queueType);
+
+  /* Connect the FlowTraceSink to all the csma devices, after the queues are set.
+   * The flows are output when the simulator is destroyed.
+   */
+  void CreateFlowTraceSink ();
     
   int                             m_numHost; 
   NodeContainer                   m_hostNodes;
   NetDeviceContainer              m_hostDevices;
   Ipv4InterfaceContainer          m_hostIPInterface;    //host ip interfaces
+  boost::unordered_map<uint32_t, int> m_hostIDByIP;     //host ip addr -> host id
   
   int                             m_numSw;
   NodeContainer                   m_switchNodes;
@@ -159,6 +187,7 @@ private:
   Graph                           m_graph;             //Store All path info
 
   Ptr<QueueController>            m_queueController;   
+  Ptr<FlowTraceSink>              m_flowTraceSink;
 };
 
   
@@ -0,0 +1,423 @@
+#include "decode-result.h"
+#include "matrix-encoder.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+#include "ns3/system-thread.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("DecodeResult");
+
+static const size_t RESULT_BUFFER_SIZE = 4 << 20;
+static const size_t RESULT_QUEUE_SIZE  = 8;        //buffers pending for the writer thread
+
+/* Writer queue wait timeout. A push or pop sets the condition then signals, so a
+ * waiter is woken at once; SystemCondition::TimedWait clears the condition on entry,
+ * so the timeout only bounds a signal lost between the queue check and the wait.
+ */
+static const uint64_t WRITER_WAIT_NS = 1000000;
+
+DecodeResultWriter::DecodeResultWriter (const std::string& filename)
+  : m_file(std::fopen(filename.c_str(), "wb")),
+    m_written(0),
+    m_section(0),
+    m_queue(RESULT_QUEUE_SIZE),
+    m_stop(false),
+    m_numStalls(0)
+{
+  NS_LOG_FUNCTION(this << filename);
+  if(!m_file)
+    NS_FATAL_ERROR("result file can not open");
+
+  m_buffer.reserve(RESULT_BUFFER_SIZE + (RESULT_BUFFER_SIZE >> 2));
+  m_buffer.insert(m_buffer.end(), RESULT_MAGIC, RESULT_MAGIC + sizeof(RESULT_MAGIC));
+
+  m_thread = Create<SystemThread>( MakeCallback(&DecodeResultWriter::WriterThread, this) );
+  m_thread->Start();
+}
+
+DecodeResultWriter::~DecodeResultWriter ()
+{
+  Close();
+}
+
+ResultSectionHeader_t
+DecodeResultWriter::NewSection (ResultSection_t type, int swID)
+{
+  ResultSectionHeader_t hd;
+  std::memset(&hd, 0, sizeof(hd));
+  hd.type = type;
+  hd.swID = swID;
+  hd.time = Simulator::Now().GetSeconds();
+  return hd;
+}
+
+void
+DecodeResultWriter::BeginSection (const ResultSectionHeader_t& hd)
+{
+  NS_ASSERT(m_thread);
+  m_section = m_buffer.size();
+  Append(hd);
+}
+
+void
+DecodeResultWriter::EndSection ()
+{
+  ResultSectionHeader_t hd;
+  std::memcpy(&hd, &m_buffer[m_section], sizeof(hd));
+  hd.offset = m_written + m_section + sizeof(hd);
+  hd.bytes  = m_buffer.size() - m_section - sizeof(hd);
+  std::memcpy(&m_buffer[m_section], &hd, sizeof(hd));
+  m_index.push_back(hd);
+
+  //The sections are written whole, the buffer is not flushed in a section
+  if(m_buffer.size() >= RESULT_BUFFER_SIZE)
+    Flush();
+}
+
+void
+DecodeResultWriter::WriteMtxBlock (int swID, uint32_t blockIdx, const MtxBlock& block)
+{
+  const MtxBlock::FlowTable_t&  flows    = block.m_flowTable;
+  const MtxBlock::CountTable_t& counters = block.m_countTable;
+
+  ResultSectionHeader_t hd = NewSection(MTX_BLOCK_SECTION, swID);
+  hd.block       = blockIdx;
+  hd.numFlows    = flows.size();
+  hd.numCounters = counters.size();
+  hd.numIdx      = MTX_NUM_IDX;
+  BeginSection(hd);
+
+  for(size_t i = 0; i < flows.size(); ++i) Append(flows[i].m_flow.ipv4srcip);
+  for(size_t i = 0; i < flows.size(); ++i) Append(flows[i].m_flow.ipv4dstip);
+  for(size_t i = 0; i < flows.size(); ++i) Append(flows[i].m_flow.srcport);
+  for(size_t i = 0; i < flows.size(); ++i) Append(flows[i].m_flow.dstport);
+  for(size_t i = 0; i < flows.size(); ++i) Append(flows[i].m_flow.ipv4prot);
+  for(size_t k = 0; k < MTX_NUM_IDX; ++k)
+    for(size_t i = 0; i < flows.size(); ++i)
+      {
+	NS_ASSERT(flows[i].m_countTableIDXs.size() == MTX_NUM_IDX);
+	Append(flows[i].m_countTableIDXs[k]);
+      }
+
+  for(size_t i = 0; i < counters.size(); ++i) Append(counters[i].m_packetCnt);
+  for(size_t i = 0; i < counters.size(); ++i) Append(counters[i].m_byteCnt);
+  for(size_t i = 0; i < counters.size(); ++i) Append(counters[i].m_flowCnt);
+
+  EndSection();
+}
+
+void
+DecodeResultWriter::Flush ()
+{
+  if(m_buffer.empty())
+    return;
+  m_written += m_buffer.size();
+
+  //Backpressure, wait for the writer thread if RESULT_QUEUE_SIZE buffers are pending
+  if(!m_queue.TryPush(m_buffer))
+    {
+      ++m_numStalls;
+      do
+	{
+	  m_notFull.TimedWait(WRITER_WAIT_NS);
+	  m_notFull.SetCondition(false);
+	}
+      while(!m_queue.TryPush(m_buffer));
+    }
+  m_notEmpty.SetCondition(true);
+  m_notEmpty.Signal();
+
+  //A written buffer is swapped back
+  m_buffer.clear();
+  m_buffer.reserve(RESULT_BUFFER_SIZE + (RESULT_BUFFER_SIZE >> 2));
+}
+
+void
+DecodeResultWriter::WriterThread ()
+{
+  std::vector<char> buffer;
+  while(true)
+    {
+      if(m_queue.TryPop(buffer))
+	{
+	  m_notFull.SetCondition(true);
+	  m_notFull.Signal();
+	  if(std::fwrite(&buffer[0], 1, buffer.size(), m_file) != buffer.size())
+	    NS_FATAL_ERROR("result file write failed");
+	  buffer.clear();
+	  continue;
+	}
+
+      //m_stop is set after the last push, the queue is checked again
+      if(__atomic_load_n(&m_stop, __ATOMIC_ACQUIRE))
+	{
+	  if(m_queue.IsEmpty())
+	    return;
+	  continue;
+	}
+      m_notEmpty.TimedWait(WRITER_WAIT_NS);
+      m_notEmpty.SetCondition(false);
+    }
+}
+
+void
+DecodeResultWriter::Close ()
+{
+  if(!m_thread)
+    return;
+
+  ResultFileFooter_t footer;
+  footer.indexOffset = m_written + m_buffer.size();
+  footer.numSections = m_index.size();
+  std::memcpy(footer.magic, RESULT_MAGIC, sizeof(RESULT_MAGIC));
+  for(size_t i = 0; i < m_index.size(); ++i)
+    Append(m_index[i]);
+  Append(footer);
+  Flush();
+
+  __atomic_store_n(&m_stop, true, __ATOMIC_RELEASE);
+  m_notEmpty.SetCondition(true);
+  m_notEmpty.Signal();
+  m_thread->Join();
+  m_thread = 0;
+
+  std::fclose(m_file);
+  m_file = NULL;
+  NS_LOG_INFO("Result file closed, " << m_index.size() << " sections " << m_written << " bytes, "
+	      << m_numStalls << " stalls on the full writer queue");
+}
+
+DecodeResultReader::DecodeResultReader (const std::string& filename)
+  : m_map(NULL), m_mapSize(0)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0)
+    NS_FATAL_ERROR("result file can not open");
+  struct stat st;
+  if(fstat(fd, &st) != 0)
+    NS_FATAL_ERROR("result file can not stat");
+
+  m_mapSize = st.st_size;
+  void* map = mmap(NULL, m_mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED)
+    NS_FATAL_ERROR("result file can not mmap");
+  m_map = (const uint8_t*)map;
+
+  if(m_mapSize < sizeof(RESULT_MAGIC) ||
+     std::memcmp(m_map, RESULT_MAGIC, sizeof(RESULT_MAGIC)) != 0)
+    NS_FATAL_ERROR("not a result file");
+
+  ResultFileFooter_t footer;
+  if(m_mapSize >= sizeof(RESULT_MAGIC) + sizeof(footer))
+    {
+      std::memcpy(&footer, m_map + m_mapSize - sizeof(footer), sizeof(footer));
+      if(std::memcmp(footer.magic, RESULT_MAGIC, sizeof(RESULT_MAGIC)) == 0 &&
+	 footer.indexOffset + footer.numSections * sizeof(ResultSectionHeader_t)
+	 + sizeof(footer) == m_mapSize)
+	{
+	  m_index.resize(footer.numSections);
+	  if(footer.numSections)
+	    std::memcpy(&m_index[0], m_map + footer.indexOffset,
+			footer.numSections * sizeof(ResultSectionHeader_t));
+	  return;
+	}
+    }
+
+  NS_LOG_WARN("result file has no index, scan the sections");
+  ScanSections();
+}
+
+DecodeResultReader::~DecodeResultReader ()
+{
+  if(m_map)
+    munmap((void*)m_map, m_mapSize);
+}
+
+void
+DecodeResultReader::ScanSections ()
+{
+  uint64_t pos = sizeof(RESULT_MAGIC);
+  while(pos + sizeof(ResultSectionHeader_t) <= m_mapSize)
+    {
+      ResultSectionHeader_t hd;
+      std::memcpy(&hd, m_map + pos, sizeof(hd));
+      if(hd.offset != pos + sizeof(hd) || hd.offset + hd.bytes > m_mapSize)
+	break;
+      m_index.push_back(hd);
+      pos = hd.offset + hd.bytes;
+    }
+}
+
+void
+DecodeResultReader::ReadFlows (size_t i, FlowInfoVec_t<PckByteCnt>& flows) const
+{
+  const ResultSectionHeader_t& hd = m_index[i];
+  NS_ASSERT(hd.type == REAL_FLOWS_SECTION || hd.type == DECODED_FLOWS_SECTION);
+
+  size_t         n       = hd.numFlows;
+  const uint8_t* ipsrc   = m_map + hd.offset;
+  const uint8_t* ipdst   = ipsrc   + 4 * n;
+  const uint8_t* srcport = ipdst   + 4 * n;
+  const uint8_t* dstport = srcport + 2 * n;
+  const uint8_t* prot    = dstport + 2 * n;
+  const uint8_t* pck     = prot    + n;
+  const uint8_t* byte    = pck     + 4 * n;
+
+  flows.clear();
+  flows.reserve(n);
+  for(size_t f = 0; f < n; ++f)
+    {
+      FlowField flow;
+      flow.ipv4srcip = Column<uint32_t>(ipsrc, f);
+      flow.ipv4dstip = Column<uint32_t>(ipdst, f);
+      flow.srcport   = Column<uint16_t>(srcport, f);
+      flow.dstport   = Column<uint16_t>(dstport, f);
+      flow.ipv4prot  = prot[f];
+      PckByteCnt cnt(Column<uint32_t>(pck, f),
+		     (hd.flags & RESULT_HAS_BYTES) ? Column<uint64_t>(byte, f) : 0);
+      flows.push_back(std::make_pair(flow, cnt));
+    }
+}
+
+void
+DecodeResultReader::ReadCounters (size_t i, std::vector<uint32_t>& counters) const
+{
+  const ResultSectionHeader_t& hd = m_index[i];
+  NS_ASSERT(hd.type == FR_COUNTERS_SECTION);
+
+  counters.resize(hd.numCounters);
+  if(hd.numCounters)
+    std::memcpy(&counters[0], m_map + hd.offset, 4 * hd.numCounters);
+}
+
+void
+DecodeResultReader::ReadMtxBlock (size_t i, MtxBlock& block) const
+{
+  const ResultSectionHeader_t& hd = m_index[i];
+  NS_ASSERT(hd.type == MTX_BLOCK_SECTION);
+
+  size_t         n       = hd.numFlows;
+  size_t         c       = hd.numCounters;
+  const uint8_t* ipsrc   = m_map + hd.offset;
+  const uint8_t* ipdst   = ipsrc   + 4 * n;
+  const uint8_t* srcport = ipdst   + 4 * n;
+  const uint8_t* dstport = srcport + 2 * n;
+  const uint8_t* prot    = dstport + 2 * n;
+  const uint8_t* idx     = prot    + n;
+  const uint8_t* pck     = idx     + 2 * n * hd.numIdx;
+  const uint8_t* byte    = pck     + 4 * c;
+  const uint8_t* flowCnt = byte    + 8 * c;
+
+  block.m_flowTable.clear();
+  block.m_flowTable.reserve(n);
+  std::vector<uint16_t> idxs(hd.numIdx);
+  for(size_t f = 0; f < n; ++f)
+    {
+      FlowField flow;
+      flow.ipv4srcip = Column<uint32_t>(ipsrc, f);
+      flow.ipv4dstip = Column<uint32_t>(ipdst, f);
+      flow.srcport   = Column<uint16_t>(srcport, f);
+      flow.dstport   = Column<uint16_t>(dstport, f);
+      flow.ipv4prot  = prot[f];
+      for(size_t k = 0; k < hd.numIdx; ++k)
+	idxs[k] = Column<uint16_t>(idx, k * n + f);
+      block.m_flowTable.push_back(MtxFlow(flow, idxs));
+    }
+
+  block.m_countTable.resize(c);
+  for(size_t ci = 0; ci < c; ++ci)
+    {
+      block.m_countTable[ci].m_packetCnt = Column<uint32_t>(pck, ci);
+      block.m_countTable[ci].m_byteCnt   = Column<uint64_t>(byte, ci);
+      block.m_countTable[ci].m_flowCnt   = Column<uint16_t>(flowCnt, ci);
+    }
+}
+
+void
+DecodeResultReader::ConvertToText (const std::string& filename, const std::string& prefix)
+{
+  NS_LOG_FUNCTION(filename << prefix);
+
+  //A prefix ending in '/' is a directory
+  if(!prefix.empty() && prefix[prefix.size() - 1] == '/')
+    {
+      if(mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+	NS_FATAL_ERROR("text directory " << prefix << " can not be created");
+    }
+
+  DecodeResultReader reader(filename);
+  for(size_t i = 0; i < reader.GetNumSections(); ++i)
+    {
+      const ResultSectionHeader_t& hd = reader.GetSection(i);
+      std::stringstream ss;
+      ss << prefix << (hd.type == MTX_BLOCK_SECTION ? "s-" : "sw-") << hd.swID << "-t-" << hd.time;
+      if(hd.type == REAL_FLOWS_SECTION)
+	ss << "-real-flow.txt";
+      else if(hd.type == DECODED_FLOWS_SECTION)
+	ss << ((hd.flags & RESULT_HAS_BYTES) ? "-measured-flow.txt" : ".txt");
+      else if(hd.type == FR_COUNTERS_SECTION)
+	ss << "-counters.txt";
+      else
+	ss << "-b-" << hd.block << ".txt";
+      std::string textFile = ss.str();
+
+      std::ofstream file(textFile.c_str());
+      NS_ASSERT( file.is_open() );
+
+      if(hd.type == REAL_FLOWS_SECTION || hd.type == DECODED_FLOWS_SECTION)
+	{
+	  FlowInfoVec_t<PckByteCnt> flows;
+	  reader.ReadFlows(i, flows);
+	  if(!(hd.flags & RESULT_HAS_BYTES) && hd.type == DECODED_FLOWS_SECTION)
+	    {
+	      file << "flows" << "\n"
+		   << "IsAllDecoded: " << ((hd.flags & RESULT_ALL_DECODED) != 0) << "\n"
+		   << "FlowCnt: "      << flows.size() << "\n";
+	    }
+	  for(size_t f = 0; f < flows.size(); ++f)
+	    {
+	      file << flows[f].first << " ";
+	      if(hd.flags & RESULT_HAS_BYTES)
+		file << flows[f].second << "\n";
+	      else
+		file << flows[f].second.m_packetCnt << "\n";
+	    }
+	}
+      else if(hd.type == FR_COUNTERS_SECTION)
+	{
+	  std::vector<uint32_t> counters;
+	  reader.ReadCounters(i, counters);
+	  file << "counters" << "\n";
+	  for(size_t c = 0; c < counters.size(); ++c)
+	    file << counters[c] << "\n";
+	}
+      else
+	{
+	  MtxBlock block;
+	  reader.ReadMtxBlock(i, block);
+	  file << "flows " << block.m_flowTable.size() << "\n";
+	  for(size_t f = 0; f < block.m_flowTable.size(); ++f)
+	    file << block.m_flowTable[f] << "\n";
+	  file << "counters" << "\n";
+	  for(size_t c = 0; c < block.m_countTable.size(); ++c)
+	    file << block.m_countTable[c] << "\n";
+	}
+      file.close();
+    }
+}
+
+}
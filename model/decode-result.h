@@ -0,0 +1,233 @@
+#ifndef DECODE_RESULT_H
+#define DECODE_RESULT_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ns3/object.h"
+#include "ns3/system-condition.h"
+
+#include "flow-field.h"
+#include "spsc-queue.h"
+
+namespace ns3
+{
+
+struct MtxBlock;
+class SystemThread;
+
+/* The decode results of a run are saved in one binary file of sections, a section
+ * is the data of a switch in a period, its columns follow its header:
+ * REAL_FLOWS_SECTION, DECODED_FLOWS_SECTION:
+ *   ipsrc u32[f], ipdst u32[f], srcport u16[f], dstport u16[f], prot u8[f], pck u32[f],
+ *   byte u64[f] if RESULT_HAS_BYTES
+ * FR_COUNTERS_SECTION:
+ *   the flow radar count table's pck u32[c]
+ * MTX_BLOCK_SECTION:
+ *   the flow columns without the cnts, count table idx u16[numIdx][f],
+ *   the count table's pck u32[c], byte u64[c], flow u16[c]
+ * f is numFlows, c is numCounters.
+ * The file starts with RESULT_MAGIC, the section headers are repeated in an index
+ * at the end, found by the footer. A file without the footer(the run is not
+ * finished) is read by scanning the sections.
+ */
+static const char RESULT_MAGIC[8] = {'D', 'C', 'R', 'S', 'L', 'T', '1', '\0'};
+
+enum ResultSection_t
+{
+  REAL_FLOWS_SECTION    = 0,
+  DECODED_FLOWS_SECTION = 1,
+  FR_COUNTERS_SECTION   = 2,
+  MTX_BLOCK_SECTION     = 3
+};
+
+static const uint32_t RESULT_HAS_BYTES   = 1;   //the flows have byte cnts
+static const uint32_t RESULT_ALL_DECODED = 2;   //the flow radar decoded all flows
+
+struct ResultSectionHeader_t
+{
+  uint32_t type;         //ResultSection_t
+  int32_t  swID;
+  double   time;         //decode time in seconds
+  uint32_t block;        //the mtx block idx
+  uint32_t flags;
+  uint32_t numFlows;
+  uint32_t numCounters;
+  uint32_t numIdx;       //count table idxs of a mtx flow
+  uint32_t reserved;
+  uint64_t offset;       //file offset of the columns
+  uint64_t bytes;        //bytes of the columns
+};
+
+struct ResultFileFooter_t
+{
+  uint64_t indexOffset;  //the section headers
+  uint64_t numSections;
+  char     magic[8];     //RESULT_MAGIC
+};
+
+/* Appends the sections to a buffer, the buffer is handed to the writer thread once
+ * it is larger than RESULT_BUFFER_SIZE, nothing is flushed per line and the
+ * simulator does not wait for the file writes.
+ * The full buffers are passed through a lock free queue of RESULT_QUEUE_SIZE buffers,
+ * the written buffers are swapped back for reuse. If the queue is full(the disk is
+ * slower than the decoders) the simulator waits for the writer thread to pop one.
+ * Close hands off the rest, waits for the writer thread to write all the buffers
+ * and closes the file, the file is complete only after Close.
+ */
+class DecodeResultWriter : public Object
+{
+public:
+  DecodeResultWriter (const std::string& filename);
+  virtual ~DecodeResultWriter ();
+
+  /* FLOWS is a container of (FlowField, cnt) pairs, the cnts are packet cnts or
+   * PckByteCnt(flags RESULT_HAS_BYTES).
+   */
+  template<class FLOWS>
+  void WriteFlows (ResultSection_t type, int swID, const FLOWS& flows, uint32_t flags);
+  /* The flows of a section of the header's type, switch, time and flags(e.g. decoded offline)
+   */
+  template<class FLOWS>
+  void WriteFlows (ResultSectionHeader_t hd, const FLOWS& flows);
+
+  void WriteMtxBlock (int swID, uint32_t blockIdx, const MtxBlock& block);
+
+  /* Write a section column by column, the numbers of the header are set by the
+   * caller, its offset and bytes by EndSection.
+   */
+  void BeginSection (const ResultSectionHeader_t& hd);
+  template<class T>
+  void Append (const T& v);
+  void EndSection ();
+
+  /* A header of the type at the switch now
+   */
+  static ResultSectionHeader_t NewSection (ResultSection_t type, int swID);
+
+  /* Write the buffer, the index and the footer, called at the end of the simulation
+   */
+  void Close ();
+
+private:
+  DecodeResultWriter(const DecodeResultWriter&);
+  DecodeResultWriter& operator=(const DecodeResultWriter&);
+
+  /* Hand the buffer off to the writer thread
+   */
+  void Flush ();
+
+  /* Write the queued buffers until Close
+   */
+  void WriterThread ();
+
+  std::FILE*                          m_file;
+  std::vector<char>                   m_buffer;
+  uint64_t                            m_written;   //bytes handed off
+  size_t                              m_section;   //buffer position of the open section
+  std::vector<ResultSectionHeader_t>  m_index;
+
+  SpscQueue<std::vector<char> >       m_queue;
+  bool                                m_stop;      //no more buffers, set by Close
+  uint64_t                            m_numStalls; //hand offs waiting for a full queue
+  SystemCondition                     m_notEmpty;
+  SystemCondition                     m_notFull;
+  Ptr<SystemThread>                   m_thread;    //null after Close
+};
+
+/* Reads the sections of a result file in place(mmap)
+ */
+class DecodeResultReader
+{
+public:
+  DecodeResultReader (const std::string& filename);
+  ~DecodeResultReader ();
+
+  size_t                        GetNumSections () const { return m_index.size(); }
+  const ResultSectionHeader_t&  GetSection (size_t i) const { return m_index[i]; }
+
+  /* The flows of a REAL_FLOWS_SECTION or DECODED_FLOWS_SECTION, the byte cnts
+   * are 0 without RESULT_HAS_BYTES
+   */
+  void ReadFlows (size_t i, FlowInfoVec_t<PckByteCnt>& flows) const;
+  void ReadCounters (size_t i, std::vector<uint32_t>& counters) const;
+  void ReadMtxBlock (size_t i, MtxBlock& block) const;
+
+  /* Write the sections of the result file as the text files the decoders used to
+   * write, for check-flow.py:
+   * sw-<id>-t-<time>-real-flow.txt, sw-<id>-t-<time>-measured-flow.txt,
+   * sw-<id>-t-<time>.txt(flow radar decoded flows), sw-<id>-t-<time>-counters.txt,
+   * s-<id>-t-<time>-b-<block>.txt(mtx blocks)
+   * The names are prefixed with prefix, e.g. "txt/"(the directory is created) or "run1-".
+   */
+  static void ConvertToText (const std::string& filename, const std::string& prefix = "");
+
+private:
+  DecodeResultReader(const DecodeResultReader&);
+  DecodeResultReader& operator=(const DecodeResultReader&);
+
+  /* Scan the section headers of a file without the footer
+   */
+  void ScanSections ();
+
+  template<class T>
+  T Column (const uint8_t* col, size_t i) const;
+
+  const uint8_t*                      m_map;
+  size_t                              m_mapSize;
+  std::vector<ResultSectionHeader_t>  m_index;
+};
+
+template<class T>
+void
+DecodeResultWriter::Append (const T& v)
+{
+  const char* p = (const char*)&v;
+  m_buffer.insert(m_buffer.end(), p, p + sizeof(T));
+}
+
+template<class FLOWS>
+void
+DecodeResultWriter::WriteFlows (ResultSection_t type, int swID, const FLOWS& flows, uint32_t flags)
+{
+  ResultSectionHeader_t hd = NewSection(type, swID);
+  hd.flags = flags;
+  WriteFlows(hd, flows);
+}
+
+template<class FLOWS>
+void
+DecodeResultWriter::WriteFlows (ResultSectionHeader_t hd, const FLOWS& flows)
+{
+  uint32_t flags = hd.flags;
+  hd.numFlows = flows.size();
+  BeginSection(hd);
+
+  typename FLOWS::const_iterator it;
+  for(it = flows.begin(); it != flows.end(); ++it) Append(it->first.ipv4srcip);
+  for(it = flows.begin(); it != flows.end(); ++it) Append(it->first.ipv4dstip);
+  for(it = flows.begin(); it != flows.end(); ++it) Append(it->first.srcport);
+  for(it = flows.begin(); it != flows.end(); ++it) Append(it->first.dstport);
+  for(it = flows.begin(); it != flows.end(); ++it) Append(it->first.ipv4prot);
+  for(it = flows.begin(); it != flows.end(); ++it) Append(FlowPacketCnt(it->second));
+  if(flags & RESULT_HAS_BYTES)
+    for(it = flows.begin(); it != flows.end(); ++it) Append(FlowByteCnt(it->second));
+
+  EndSection();
+}
+
+template<class T>
+T
+DecodeResultReader::Column (const uint8_t* col, size_t i) const
+{
+  T v;
+  std::memcpy(&v, col + i * sizeof(T), sizeof(T));
+  return v;
+}
+
+}
+
+#endif
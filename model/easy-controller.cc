@@ -1,9 +1,12 @@
 
 #include <iostream>
+#include <cstddef>
+#include <limits>
 
 #include "easy-controller.h"
 #include "openflow-switch-net-device.h"
 #include "dc-topology.h"
+#include "flow-field.h"
 
 namespace ns3 {
 
@@ -23,11 +26,87 @@ EasyController::GetTypeId (void)
   return tid;
 }
 
+const uint16_t EasyController::FLOW_IDLE_TIMEOUT;
+
+EasyController::EasyController ()
+  : m_flowModErrorMetric (RadarMetrics::RegisterCounter ("controller.flow-mod-errors"))
+{
+}
+
 void
 EasyController::ReceiveFromSwitch (Ptr<OpenFlowSwitchNetDevice> swtch, ofpbuf* buffer)
 {
-  NS_LOG_ERROR("Receive packet can not route");
-  return;
+  if (m_switches.find (swtch) == m_switches.end ())
+    {
+      NS_LOG_ERROR ("Can't receive from this switch, not registered to the Controller.");
+      return;
+    }
+
+  uint8_t type = GetPacketType (buffer);
+  if (type == OFPT_FLOW_EXPIRED)
+    {
+      //The idle flow's rule is freed, its next packet misses and sets it again
+      return;
+    }
+  if (type == OFPT_ERROR)
+    {
+      ReceiveError (swtch, buffer);
+      return;
+    }
+  if (type != OFPT_PACKET_IN)
+    {
+      NS_LOG_ERROR("Receive packet can not route");
+      return;
+    }
+
+  ofp_packet_in * opi = (ofp_packet_in*)ofpbuf_try_pull (buffer, offsetof (ofp_packet_in, data));
+  int port = ntohs (opi->in_port);
+
+  //Create the exact matching key of the missed packet
+  sw_flow_key key;
+  key.wildcards = 0;
+  flow_extract (buffer, port != -1 ? port : OFPP_NONE, &key.flow);
+
+  //The flow's 5 tuple, the same as FlowFieldFromPacket extracts
+  FlowField flow;
+  flow.ipv4srcip = ntohl (key.flow.nw_src);
+  flow.ipv4dstip = ntohl (key.flow.nw_dst);
+  flow.srcport   = ntohs (key.flow.tp_src);
+  flow.dstport   = ntohs (key.flow.tp_dst);
+  flow.ipv4prot  = key.flow.nw_proto;
+
+  int from = m_topo->GetHostID (flow.ipv4srcip);
+  int to   = m_topo->GetHostID (flow.ipv4dstip);
+  if (ntohs (key.flow.dl_type) != ETH_TYPE_IP
+      || from < 0 || from >= (int)m_topo->GetNumHost ()
+      || to   < 0 || to   >= (int)m_topo->GetNumHost ())
+    {
+      NS_LOG_ERROR("Receive packet can not route " << flow);
+      return;
+    }
+
+  NS_LOG_INFO("Flow " << flow << " missed, set its ECMP path");
+  SetFlowOnPath (m_topo->GetPath (from, to, flow), key, swtch, opi->buffer_id);
+}
+
+void
+EasyController::ReceiveError (Ptr<OpenFlowSwitchNetDevice> swtch, ofpbuf* buffer)
+{
+  ofp_error_msg* oem  = (ofp_error_msg*)buffer->data;
+  uint16_t       type = ntohs (oem->type);
+  uint16_t       code = ntohs (oem->code);
+
+  RadarMetrics::Add (m_flowModErrorMetric);
+  NS_LOG_ERROR ("Switch " << swtch->GetAddress () << " flow mod failed, type " << type
+		<< " code " << code << ", " << RadarMetrics::GetCounter (m_flowModErrorMetric)
+		<< " failures");
+
+  //The buffered packet is dropped and the flow's later packets would miss and be dropped
+  //again, the results would be silently wrong
+  if (type == OFPET_FLOW_MOD_FAILED && code == OFPFMFC_ALL_TABLES_FULL)
+    NS_FATAL_ERROR ("Flow table of switch " << swtch->GetAddress () << " is full");
+  NS_FATAL_ERROR ("Flow mod on switch " << swtch->GetAddress () << " failed, type "
+		  << type << " code " << code);
 }
   
 void
@@ -44,52 +123,35 @@ EasyController::SetDefaultFlowTable ()
   NS_LOG_FUNCTION(this);
 
   const unsigned          numHost  = m_topo->GetNumHost(); 
+  const unsigned          numSW    = m_topo->GetNumSW();
 
-  /*
-  for(unsigned i = 0; i < numNodes; ++i)
-    {
-      NS_LOG_LOGIC("id: "<<i);
-      for(unsigned j = 0; j < adjList[i].size(); ++j)
-	{
-	  std::cout << adjList[i][j].from_port << " " <<
-		       adjList[i][j].to_port << " " <<
-	               adjList[i][j].id << std::endl;
-	}
-
-    }
-  */
- 
-  for(unsigned from = 0; from < numHost; ++from)
+  std::vector<uint16_t>   ports;
+  for(unsigned swID = numHost; swID < numHost + numSW; ++swID)
     {
       for(unsigned to = 0; to < numHost; ++to)
 	{
-	  if(from == to) continue;
-	  Graph::Path_t path = m_topo->GetPath(from, to);
-	  
-	  NS_LOG_INFO("Built path from " << from << " to " << to);
-	    
-	  SetFlowOnPath (path);
+	  Ipv4Address ipDstAddr = m_topo->GetHostIPAddr (to);
+	  m_topo->GetNextHopPorts (swID, to, ports);
+
+	  //Add the route table entry to the QueueController, if no queuecontroller, nothing will happen
+	  for(size_t ith = 0; ith < ports.size(); ++ith)
+	    {
+	      m_topo->AddRouteTableEntry(swID, ipDstAddr, ports[ith]);
+	    }
 	}
     }
 }
 
   
 void
-EasyController::SetFlowOnPath(const Graph::Path_t& path)
+EasyController::SetFlowOnPath(const Graph::Path_t& path, const sw_flow_key& key,
+			      Ptr<OpenFlowSwitchNetDevice> missSwtch, uint32_t buffer_id)
 {
   int lst = path.size() - 1;
-  //prepare the flow source host;
-  int         srcHID     = path[0].src;
-  Address     macSrcAddr = m_topo->GetHostMacAddr (srcHID);
-  Ipv4Address ipSrcAddr  = m_topo->GetHostIPAddr  (srcHID);  
-
 
-  //prepare the flow dst host
-  int         dstHID     = path[lst].dst;
-  Address     macDstAddr = m_topo->GetHostMacAddr (dstHID);
-  Ipv4Address ipDstAddr  = m_topo->GetHostIPAddr  (dstHID);
-
-  for(int ith = 0; ith < lst; ++ith)
+  //Set the switches backwards, the buffered packet is released on the missed
+  //switch after all the switches behind it know the flow.
+  for(int ith = lst - 1; ith >= 0; --ith)
     {
       const Graph::Edge_t& inEdge  = path[ith];
       const Graph::Edge_t& outEdge = path[ith + 1];
@@ -102,17 +164,13 @@ EasyController::SetFlowOnPath(const Graph::Path_t& path)
 
       Ptr<OpenFlowSwitchNetDevice> swtch = m_topo->GetOFSwtch (swID);
       
-      ProactiveModFlow (swtch, OFPFC_ADD, swOutPort, swInPort,
-			macSrcAddr, macDstAddr, ipSrcAddr, ipDstAddr,
-			-1, -1); //tcp/udp dont consider
+      ProactiveModFlow (swtch, OFPFC_ADD, swOutPort, swInPort, key,
+			swtch == missSwtch ? buffer_id : std::numeric_limits<uint32_t>::max());
 
       NS_LOG_INFO("Swtch " << swID << " proactively add flow from "
-		  << ipSrcAddr << "|" << macSrcAddr
-		  << " to " << ipDstAddr << "|" << macDstAddr
+		  << Ipv4Address (ntohl (key.flow.nw_src))
+		  << " to " << Ipv4Address (ntohl (key.flow.nw_dst))
 		  << " in_port: " << swInPort << " out_port: " << swOutPort);
-      
-      //Add the route table entry to the QueueController, if no queuecontroller, nothing will happen
-      m_topo->AddRouteTableEntry(swID, ipDstAddr, swOutPort);
     }
 }
   
@@ -120,18 +178,14 @@ void
 EasyController::ProactiveModFlow (Ptr<OpenFlowSwitchNetDevice> swtch,
 				  uint16_t command,
 				  uint16_t out_port, uint16_t in_port,
-				  Address mac_src, Address mac_dst,
-				  Ipv4Address ip_src, Ipv4Address ip_dst,
-				  uint16_t port_src, uint16_t port_dst)
+				  sw_flow_key key, uint32_t buffer_id)
 {
 
   NS_ASSERT (m_switches.find(swtch) != m_switches.end());
   
-  //Create the matching key:
-  sw_flow_key key;
-  key.wildcards = htonl(OFPFW_NW_PROTO); //flow wildcards, defined in openflow.h 
-  
-  FlowExtract(&key.flow, in_port, mac_src, mac_dst, ip_src, ip_dst, port_src, port_dst);
+  //Create the matching key: exact match, the in_port of this switch
+  key.wildcards    = 0;
+  key.flow.in_port = htons (in_port);
 
   //Create the output-to-port action
   ofp_action_output x[1];
@@ -139,60 +193,12 @@ EasyController::ProactiveModFlow (Ptr<OpenFlowSwitchNetDevice> swtch,
   x[0].len  = htons (sizeof(ofp_action_output));
   x[0].port = out_port;
 
-  //buffer_id does not exist
-  uint32_t buffer_id = htonl (std::numeric_limits<uint32_t>::max());
-  ofp_flow_mod * ofm = BuildFlow (key, buffer_id, command, x, sizeof(x), OFP_FLOW_PERMANENT, OFP_FLOW_PERMANENT);
+  ofp_flow_mod * ofm = BuildFlow (key, buffer_id, command, x, sizeof(x),
+				  FLOW_IDLE_TIMEOUT, OFP_FLOW_PERMANENT);
   
   SendToSwitch (swtch, ofm, ofm->header.length);  
 }
 
-
-void
-EasyController::FlowExtract (struct flow * flow_in_key,
-			     uint16_t in_port,
-			     Address mac_src, Address mac_dst,
-			     Ipv4Address ip_src, Ipv4Address ip_dst,
-			     uint16_t port_src, uint16_t port_dst)
-{
-
-  memset(flow_in_key, 0, sizeof(*flow_in_key));
-
-
-  //Input VLAN vlan disable openflow.h
-  flow_in_key->dl_vlan = htons (OFP_VLAN_NONE);
-  //Input switch port
-  flow_in_key->in_port = htons (in_port);
-
-
-  //Ethernet frame type: Ethernet IP (No Ethernet Arp, because we set the
-  //host's cache permanently). So we need to set nw_src, nw_dst.
-  flow_in_key->dl_type = htons (ETH_TYPE_IP);
-  //Ethernet address.
-  Mac48Address mac48_src = Mac48Address::ConvertFrom(mac_src);
-  Mac48Address mac48_dst = Mac48Address::ConvertFrom(mac_dst);
-  mac48_src.CopyTo (flow_in_key->dl_src);
-  mac48_dst.CopyTo (flow_in_key->dl_dst);
-  //MAH: start MPLS_INVALID_LABEL private\packet.h
-  flow_in_key->mpls_label1 = htonl (MPLS_INVALID_LABEL);
-  flow_in_key->mpls_label2 = htonl (MPLS_INVALID_LABEL);
-
-  
-  //IP source address
-  flow_in_key->nw_src = htonl (ip_src.Get ());
-  flow_in_key->nw_dst = htonl (ip_dst.Get ());
-  //IP protocal
-  //openflow/lib/flow.cc set nw_proto=0 to avoid
-  //tricking other code into thinking that this packet has a L4 packet.
-  flow_in_key->nw_proto = 0;
-
-  //TCP UDP port
-  flow_in_key->tp_src = htons (port_src);
-  flow_in_key->tp_dst = htons (port_dst);
-
-  return;
-  
-}
-
       
 }
 
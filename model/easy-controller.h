@@ -7,6 +7,7 @@
 
 #include "openflow-interface.h"
 #include "graph-algo.h" //can not forward declare Graph::Path_t, it's a typedef
+#include "radar-metrics.h"
 
 namespace ns3 {
 
@@ -20,27 +21,36 @@ class EasyController : public Controller
 public:
   static TypeId GetTypeId (void);
 
+  EasyController ();
+
   void SetTopo (Ptr<ns3::DCTopology> topo);
   
-  /* Use Dijkstra algorithm with the adj list to compute the shortest path
-   * betewn each hosts. Set the switches's flow table along the path.
-   *
+  /* The flows are routed by per flow ECMP, so the forwarding rules are set
+   * when a flow's first packet misses the flow table(see ReceiveFromSwitch).
+   * Here we only register each switch's ECMP next hop groups to the
+   * QueueController, it maps the decoded flows to the queues with them.
    */
   void SetDefaultFlowTable ();
   
-  /*Inherit from Controller*/
+  /*Inherit from Controller
+   *On a flow table miss(OFPT_PACKET_IN), get the flow's ECMP path and set
+   *the flow on the switches of the path. An expired flow(OFPT_FLOW_EXPIRED) is
+   *set again at its next miss. A failed flow mod(OFPT_ERROR, e.g. the flow
+   *table is full) stops the run, its flow's packets would be dropped.
+   */
   void ReceiveFromSwitch (Ptr<OpenFlowSwitchNetDevice> swtch, ofpbuf* buffer);
 
    
 private:
-  /* Build the struct flow (openflow/private/flow.h) from the flow info
-   * Use by ProactiveModFlow Function to prepare the sw_flow_key.flow.
+  /* The exact match rules are freed after this idle time, so the flow tables hold
+   * the active flows only. In seconds of the OFSID clock, its granularity(the
+   * flow expiration runs once a second), a few MTX_PERIODs would round to 0.
+   */
+  static const uint16_t FLOW_IDLE_TIMEOUT = 1;
+
+  /* Log and count the OFPT_ERROR of a flow mod, then stop the run
    */
-  void FlowExtract (struct flow * flow_in_key,
-		    uint16_t in_port,
-		    Address mac_src, Address mac_dst,
-		    Ipv4Address ip_src, Ipv4Address ip_dst,
-		    uint16_t port_src, uint16_t port_dst);
+  void ReceiveError (Ptr<OpenFlowSwitchNetDevice> swtch, ofpbuf* buffer);
 
   /* Proactively modify the flow entry on the OpenFlowSwitch' flow  
    * table with the OFPT_FLOW_MOD message, the actual type of the flow modification
@@ -51,26 +61,28 @@ private:
    * @command:  the flow action: OFPFC_ADD(add a flow entry), OFPFC_MODIFY, OFPFC_M
    *           DIFY_STRICT, OFPFC_DELETE, OFPFC_DELETE_STRICT.
    * @out_port: the outport of the action.
-   * ----------flow param---------------
-   * @
+   * @in_port:  the inport of the flow on this switch.
+   * @key:      the exact match key of the flow, extracted from the missed packet.
+   * @buffer_id: the buffered packet to run the action on, -1 if none.
+   * The rule expires after FLOW_IDLE_TIMEOUT without packets.
    */ 
   void ProactiveModFlow (Ptr<OpenFlowSwitchNetDevice> swtch, uint16_t command,
 			 uint16_t out_port, uint16_t in_port,
-			 Address mac_src, Address mac_dst,
-			 Ipv4Address ip_src, Ipv4Address ip_dst,
-			 uint16_t port_src, uint16_t port_dst);
+			 sw_flow_key key, uint32_t buffer_id);
 
-  /* @path represents a flow of packets(ip layer) 
+  /* @path represents a flow of packets(5 tuple) 
    * Add this flow entry into the flow table of the switches
    * on the path.
    *
-   * Attention, we also add the route table( dstip-port ) of each sw to QueueController
-   * QueueController use this information to decide which queue the flow packets is in. 
+   * The switch the packet missed on gets the buffer_id, so the buffered
+   * packet goes on along the path.
    */
-  void SetFlowOnPath (const ns3::Graph::Path_t& path);
+  void SetFlowOnPath (const ns3::Graph::Path_t& path, const sw_flow_key& key,
+		      Ptr<OpenFlowSwitchNetDevice> missSwtch, uint32_t buffer_id);
 
   
-  Ptr<ns3::DCTopology>  m_topo; //data center network topo
+  Ptr<ns3::DCTopology>      m_topo; //data center network topo
+  RadarMetrics::MetricId_t  m_flowModErrorMetric;  //controller.flow-mod-errors
     
 };
 
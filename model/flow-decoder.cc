@@ -1,4 +1,3 @@
-#include <fstream>
 #include <algorithm>
 #include <sstream>
 
@@ -9,6 +8,7 @@
 #include "flow-decoder.h"
 #include "flow-encoder.h"
 #include "flow-field.h"
+#include "stage-timer.h"
 #include "LSXR/lsqrDense.h"
 #include "LSXR/lsmrDense.h"
 
@@ -19,8 +19,16 @@ namespace ns3
 NS_LOG_COMPONENT_DEFINE("FlowDecoder");
   
 FlowDecoder::FlowDecoder (Ptr<DCTopology> topo)
-  : m_topo (topo)
+  : m_numHost (topo->GetNumHost ()),
+    m_passNewFlows (FlowSet_t::allocator_type(m_memAccount.GetCounter(MEM_DECODED_FLOWS))),
+    m_topo (topo),
+    m_checker ("fr-accuracy.txt"),
+    m_saver (Create<CheckpointSaver>()),
+    m_numDecode (0),
+    m_resumeTime (0.),
+    m_restored (false)
 {
+  m_encoderByID.resize (topo->GetNumSW ());
 }
 
 FlowDecoder::~FlowDecoder ()
@@ -32,11 +40,20 @@ FlowDecoder::DecodeFlows ()
 {
   NS_LOG_FUNCTION(Simulator::Now().GetSeconds());
 
-  //prepare the output file.
+  //save the encoders before they are decoded and cleared
+  ++m_numDecode;
+  if(CHECKPOINT_PERIODS > 0 && m_numDecode % CHECKPOINT_PERIODS == 0 && !m_restored)
+    Checkpoint();
+  m_restored = false;
+
+  //prepare the switches' status.
   StatInit();
 
-  OutputOriginalCounter();
-  OutputRealFlows();
+  if(OUTPUT_FLOWS)
+    {
+      OutputOriginalCounter();
+      OutputRealFlows();
+    }
   
   /*  1. Flow decode in this frame    */
   unsigned pass = 0;
@@ -47,10 +64,14 @@ FlowDecoder::DecodeFlows ()
       for(itFlow = m_passNewFlows.begin();
 	  itFlow != m_passNewFlows.end(); ++itFlow)
 	{
-	  //Hacking: the node id == the last Ipv4 address section - 1
-	  int           from = ((*itFlow).ipv4srcip & 0xff) - 1;
-	  int           to   = ((*itFlow).ipv4dstip & 0xff) - 1;
-	  Graph::Path_t path = m_topo->GetPath(from, to);
+	  int           from = m_topo->GetHostID ((*itFlow).ipv4srcip);
+	  int           to   = m_topo->GetHostID ((*itFlow).ipv4dstip);
+	  if(from < 0 || to < 0)
+	    {
+	      NS_LOG_WARN("Decoded flow " << *itFlow << " is not between hosts");
+	      continue;
+	    }
+	  Graph::Path_t path = m_topo->GetPath(from, to, *itFlow);
 
 	  DecodeFlowOnPath (path, *itFlow);
 	}
@@ -59,9 +80,22 @@ FlowDecoder::DecodeFlows ()
   /*   2.Counter Decode in this frame    */
   CounterAllDecode();
   
-  /*   3.Output the decoded info        */
-  NS_LOG_INFO("Saving the decoded data");
-  OutputDecodeInfo();
+  /*   3.Check and output the decoded info        */
+  for (unsigned ith = 0; ith < m_encoders.size(); ++ith)
+    {
+      const int swID = m_encoders[ith]->GetID();
+      m_checker.Check(swID, m_encoders[ith]->GetRealFlowCounter(), GetStat(swID).decodedFlowInfo);
+    }
+  m_checker.EndPeriod();
+
+  if(OUTPUT_FLOWS)
+    {
+      NS_LOG_INFO("Saving the decoded data");
+      OutputDecodeInfo();
+    }
+
+  //The memory breakdown at the period's peak, before the clear
+  MemAccounting::Report(Simulator::Now().GetSeconds());
 
   /*   4. Clear all the infos(Decoder and Encoder) in this decoding frame */
   NS_LOG_INFO("Clear FlowRadar Status");
@@ -87,95 +121,47 @@ FlowDecoder::DecodeFlows ()
 void
 FlowDecoder::OutputOriginalCounter()
 {
- 
- 
- SWStat_t::const_iterator itsw;
- for(itsw = m_swStat.begin();
-     itsw != m_swStat.end(); ++itsw)
-   {
-     int               swID     = itsw->first;
-     const Stat_t     &swStat   = itsw->second;
-     std::ofstream    &file     = *(swStat.pSaveFile);
-     Ptr<FlowEncoder>  target   = GetEncoderByID(swID);
-
-     //Output Original Counters
-     file << "counters" << std::endl;
-     FlowEncoder::CountTable_t::const_iterator itc;
-     const FlowEncoder::CountTable_t& counterTable = target->GetCountTable();
-     for(itc = counterTable.begin(); itc != counterTable.end(); ++itc)
-       {
-	 file << itc->packet_cnt << std::endl;
-       }
-   }
-  
+  STAGE_TIMER(STAGE_OUTPUT);
+  for(unsigned ith = 0; ith < m_encoders.size(); ++ith)
+    {
+      Ptr<FlowEncoder>                 target       = m_encoders[ith];
+      const FlowEncoder::CountTable_t& counterTable = target->GetCountTable();
+
+      ResultSectionHeader_t hd = DecodeResultWriter::NewSection(FR_COUNTERS_SECTION, target->GetID());
+      hd.numCounters = counterTable.size();
+      Ptr<DecodeResultWriter> writer = GetWriter();
+      writer->BeginSection(hd);
+      FlowEncoder::CountTable_t::const_iterator itc;
+      for(itc = counterTable.begin(); itc != counterTable.end(); ++itc)
+	{
+	  writer->Append(itc->packet_cnt);
+	}
+      writer->EndSection();
+    }
 }
 
 void
 FlowDecoder::OutputRealFlows()
 {
-
- 
- SWStat_t::const_iterator itsw;
- for(itsw = m_swStat.begin();
-     itsw != m_swStat.end(); ++itsw)
-   {
-     int               swID     = itsw->first;
-     Ptr<FlowEncoder>  target   = GetEncoderByID(swID);
-
-     //Output Real Flow Size
-     std::string rffilename = "sw-";
-     std::stringstream ss;
-     ss << rffilename << swID << "-t-"<<Simulator::Now().GetSeconds()<<"-real-flow.txt";
-     ss >> rffilename;
-     std::ofstream rffile(rffilename.c_str());
-     FlowEncoder::FlowInfo_t::const_iterator itf; 
-     const FlowEncoder::FlowInfo_t& realFlows = target->GetRealFlowCounter();
-     for(itf = realFlows.begin(); itf != realFlows.end(); ++itf)
-       {
-	 rffile << itf->first << " " << itf->second << std::endl;
-       }
-   }
+  STAGE_TIMER(STAGE_OUTPUT);
+  for(unsigned ith = 0; ith < m_encoders.size(); ++ith)
+    {
+      GetWriter()->WriteFlows(REAL_FLOWS_SECTION, m_encoders[ith]->GetID(),
+			      m_encoders[ith]->GetRealFlowCounter(), 0);
+    }
 }
 
 void
 FlowDecoder::OutputDecodeInfo()
 {
-  
-  SWStat_t::const_iterator itsw;
-  for(itsw = m_swStat.begin();
-      itsw != m_swStat.end(); ++itsw)
+  STAGE_TIMER(STAGE_OUTPUT);
+  for(unsigned ith = 0; ith < m_encoders.size(); ++ith)
     {
-      int               swID     = itsw->first;
-      const Stat_t     &swStat   = itsw->second;
-      std::ofstream    &file     = *(swStat.pSaveFile);
-      Ptr<FlowEncoder>  target   = GetEncoderByID(swID);
-      if(!file)
-	{
-	  NS_LOG_ERROR("Decoded flow file is not open");
-	}
-
-      file << "flows" <<std::endl;
-      //file <<"Time: "         << Simulator::Now().GetSeconds() << std::endl;
-      file <<"IsAllDecoded: " << swStat.IsAllDecoded           << std::endl;
-      file <<"FlowCnt: "      << swStat.numFlow                << std::endl;
-      
-      // Output All decoded flows
-      // srcip dstip port srcport dstport hashpos1 hashpos2 ...
-      //
-      const FlowInfo_t &flowInfo = itsw->second.decodedFlowInfo;
-      FlowInfo_t::const_iterator itFlow;
-      for(itFlow = flowInfo.begin(); itFlow != flowInfo.end(); ++itFlow)
-	{
-	  file << itFlow->first; // << itFlow->second << std::endl;
-	  std::vector<uint32_t> idxs =  target->GetCountTableIdx( itFlow->first );
-	  for(size_t i = 0; i < idxs.size(); ++i)
-	    {
-	      file << " " << idxs[i];
-	    }
-	  file << std::endl;
-	}
+      const int     swID   = m_encoders[ith]->GetID();
+      const Stat_t &swStat = GetStat(swID);
+      GetWriter()->WriteFlows(DECODED_FLOWS_SECTION, swID, swStat.decodedFlowInfo,
+			      swStat.IsAllDecoded ? RESULT_ALL_DECODED : 0);
     }
-  
 }
   
 bool
@@ -202,55 +188,111 @@ FlowDecoder::Init()
       m_workerThreads.push_back (workerThread);
     }
   
-  Simulator::Schedule (Seconds(PERIOD), &FlowDecoder::DecodeFlows, this);
+  m_firstDecode = Simulator::Schedule (Seconds(m_restored ? m_resumeTime : PERIOD),
+				       &FlowDecoder::DecodeFlows, this);
+  Simulator::ScheduleDestroy (&CheckpointSaver::Wait, m_saver);
 }
 
-void
-FlowDecoder::AddEncoder (Ptr<FlowEncoder> encoder)
+Ptr<DecodeResultWriter>
+FlowDecoder::GetWriter()
 {
-  m_encoders.push_back(encoder);
+  if(!m_writer)
+    {
+      std::stringstream ss;
+      ss << "fr-result";
+      if(m_resumeTime > 0.)
+	ss << "-t-" << m_resumeTime;
+      ss << ".dcr";
+      m_writer = Create<DecodeResultWriter>(ss.str());
+      Simulator::ScheduleDestroy (&DecodeResultWriter::Close, m_writer);
+    }
+  return m_writer;
 }
 
+void
+FlowDecoder::Checkpoint()
+{
+  double now = Simulator::Now().GetSeconds();
+  NS_LOG_FUNCTION(now);
+
+  CheckpointOut      out;
+  CheckpointHeader_t hd;
+  std::memset(&hd, 0, sizeof(hd));
+  std::memcpy(hd.magic, CHECKPOINT_MAGIC, sizeof(hd.magic));
+  hd.radar       = FLOW_RADAR_CHECKPOINT;
+  hd.numEncoders = m_encoders.size();
+  hd.time        = now;
+  hd.numDecode   = m_numDecode;
+  out.Put(hd);
+  for(unsigned ith = 0; ith < m_encoders.size(); ++ith)
+    {
+      m_encoders[ith]->Save(out);
+    }
 
-Ptr<FlowEncoder>
-FlowDecoder::GetEncoderByID (int swID)
+  std::stringstream ss;
+  ss << "fr-ckpt-t-" << now << ".ckpt";
+  m_saver->Save(ss.str(), out);
+}
+
+void
+FlowDecoder::Restore(const std::string& filename)
 {
-  Ptr<FlowEncoder> e;
+  NS_LOG_FUNCTION(filename);
+
+  CheckpointIn       in(filename);
+  CheckpointHeader_t hd;
+  in.Get(hd);
+  if(std::memcmp(hd.magic, CHECKPOINT_MAGIC, sizeof(hd.magic)) != 0 ||
+     hd.radar != FLOW_RADAR_CHECKPOINT)
+    NS_FATAL_ERROR("not a flow radar checkpoint");
+  if(hd.numEncoders != m_encoders.size())
+    NS_FATAL_ERROR("checkpoint has " << hd.numEncoders << " encoders, the topology has " << m_encoders.size());
+
   for(unsigned ith = 0; ith < m_encoders.size(); ++ith)
     {
-      e = m_encoders[ith];
-      if( e->GetID() == swID)
-	break;
+      m_encoders[ith]->Restore(in);
     }
+  NS_ASSERT(in.AtEnd());
 
-  return e;
+  //The restored period is decoded at the checkpoint time and counted again there
+  m_numDecode  = hd.numDecode - 1;
+  m_resumeTime = hd.time;
+  m_restored   = true;
+  if(!m_firstDecode.IsExpired())
+    {
+      m_firstDecode.Cancel();
+      m_firstDecode = Simulator::Schedule (Seconds(m_resumeTime) - Simulator::Now(),
+					   &FlowDecoder::DecodeFlows, this);
+    }
+  NS_LOG_INFO("Restored " << m_encoders.size() << " encoders at " << m_resumeTime);
 }
 
+void
+FlowDecoder::AddEncoder (Ptr<FlowEncoder> encoder)
+{
+  m_encoders.push_back(encoder);
+
+  NS_ASSERT(!m_encoderByID[encoder->GetID() - m_numHost]);
+  m_encoderByID[encoder->GetID() - m_numHost] = encoder;
+}
+
+
 void 
 FlowDecoder::StatInit()
 {
+  //Reset in place, the stats keep their allocators
+  m_swStat.resize(m_encoderByID.size(),
+		  Stat_t(FlowInfo_t::allocator_type(m_memAccount.GetCounter(MEM_DECODED_FLOWS))));
   for(unsigned ith = 0; ith < m_encoders.size(); ++ith)
     {
       const int swID = m_encoders[ith]->GetID();
       
       //m_curSWFlowInfo[swID] = FlowInfo_t();
-      
-      std::string filename = "sw-";
-      std::string time     = "-t-";
-      std::stringstream ss;
-      ss << filename << swID << time << Simulator::Now().GetSeconds() << ".txt";
-      filename.clear();
-      ss >> filename;
 
-      m_swStat[swID] = Stat_t();
-      
-      if( !(*(m_swStat[swID].pSaveFile
-	      = new std::ofstream(filename.c_str()))))
-	{
-	  NS_LOG_ERROR("Switch save file open failed");
-	  return;
-	}
-      
+      Stat_t& stat = GetStat(swID);
+      stat.IsAllDecoded = true;
+      stat.numFlow      = 0;
+      stat.decodedFlowInfo.clear();
     }
 }
   
@@ -262,6 +304,7 @@ bool IsFlowCountOne(const FlowEncoder::CountTableEntry& e)
 void
 FlowDecoder::FlowSingleDecode(Ptr<FlowEncoder> target)
 {
+  STAGE_TIMER(STAGE_FLOW_SINGLE_DECODE);
 
   int swID = target->GetID();
 
@@ -278,7 +321,7 @@ FlowDecoder::FlowSingleDecode(Ptr<FlowEncoder> target)
       //NS_LOG_INFO ("Flow: "<< flow );
       
       //m_curSWFlowInfo[swID][flow] = packetCnt;
-      m_swStat[swID].decodedFlowInfo[flow] = packetCnt;
+      GetStat(swID).decodedFlowInfo[flow] = packetCnt;
 
       /* If it's a new flow doesn't collected among switches before,
        * add to m_passNewFlows
@@ -296,13 +339,14 @@ FlowDecoder::FlowSingleDecode(Ptr<FlowEncoder> target)
 void
 FlowDecoder::DecodeFlowOnPath (const Graph::Path_t& path, const FlowField& flow)
 {
+  STAGE_TIMER(STAGE_DECODE_FLOW_ON_PATH);
   
   unsigned lst = path.size() - 1;
   for(unsigned ith = 0; ith < lst; ++ith)
     {
       int          swID          = path[ith].dst;
       //FlowInfo_t&  swDcdFlowInfo = m_curSWFlowInfo.at (swID);
-      FlowInfo_t& swDcdFlowInfo = m_swStat[swID].decodedFlowInfo;
+      FlowInfo_t& swDcdFlowInfo = GetStat(swID).decodedFlowInfo;
       
       
       FlowInfo_t::iterator itFlow;
@@ -364,13 +408,14 @@ FlowDecoder::WorkerThread()
 std::string
 FlowDecoder::CounterSingleDecode (Ptr<FlowEncoder> target)
 {
+  STAGE_TIMER(STAGE_COUNTER_DECODE);
 
   std::ostringstream oss;
   
   int            swID   = target->GetID();
   const unsigned m      = COUNT_TABLE_SIZE; //Row
   //const unsigned n      = m_curSWFlowInfo.at(swID).size(); //Col
-  const unsigned n      = m_swStat[swID].decodedFlowInfo.size(); 
+  const unsigned n      = GetStat(swID).decodedFlowInfo.size(); 
 
   oss << "Counter Decode at " << swID << "\n"
       << "Flows to cal: " << n << "\n";
@@ -496,9 +541,9 @@ FlowDecoder::ConstructLinearEquations (double* A[], double b[],
  
   int                        swID           = target->GetID();
   //FlowInfo_t                &swDcdFlowInfo  = m_curSWFlowInfo.at (swID);
-  FlowInfo_t                &swDcdFlowInfo  = m_swStat[swID].decodedFlowInfo;
+  Stat_t                    &swStat         = GetStat(swID);
+  FlowInfo_t                &swDcdFlowInfo  = swStat.decodedFlowInfo;
   FlowEncoder::CountTable_t &swCountTable   = target->GetCountTable();
-  Stat_t                    &swStat         = m_swStat.at(swID);
 
   //Update the swtch status,
   swStat.numFlow = swDcdFlowInfo.size();
@@ -554,11 +599,9 @@ FlowDecoder::Clear()
   SWStat_t::iterator itStat;
   for( itStat = m_swStat.begin(); itStat != m_swStat.end(); ++itStat )
     {
-      (itStat->second).IsAllDecoded = true;
-      (itStat->second).numFlow      = 0;
-      (itStat->second).decodedFlowInfo.clear();
-      (itStat->second).pSaveFile->close();
-      delete (itStat->second).pSaveFile;
+      itStat->IsAllDecoded = true;
+      itStat->numFlow      = 0;
+      itStat->decodedFlowInfo.clear();
     }
 }
 
@@ -7,6 +7,7 @@
 #include <boost/unordered_set.hpp>
 
 #include "ns3/object.h"
+#include "ns3/event-id.h"
 #include "ns3/system-condition.h"
 #include "ns3/system-mutex.h"
 
@@ -14,6 +15,10 @@
 #include "dc-topology.h"
 #include "graph-algo.h"
 #include "work-queue.h"
+#include "accuracy-checker.h"
+#include "decode-result.h"
+#include "radar-checkpoint.h"
+#include "mem-accounting.h"
 
 namespace ns3
 {
@@ -34,34 +39,54 @@ public:
   /* Schedule the decode event and Init containers
    */
   void Init ();
+
+  /* Restore the encoders from a checkpoint(fr-ckpt-t-<time>.ckpt), the decoding
+   * resumes at the checkpoint time, the traffic before it should not be replayed.
+   * The encoders must be added in the order of the saving run.
+   */
+  void Restore (const std::string& filename);
   
 private:
   FlowDecoder(const FlowDecoder&);
   FlowDecoder& operator=(const FlowDecoder&);
 
   /*the decoded flows, key: FlowField, value: packet cnt*/
-  typedef boost::unordered_map<FlowField, uint32_t, FlowFieldBoostHash>  FlowInfo_t;
+  typedef boost::unordered_map<FlowField, uint32_t, FlowFieldBoostHash, std::equal_to<FlowField>,
+			       TrackingAllocator<std::pair<const FlowField, uint32_t> > >  FlowInfo_t;
   
   struct Stat_t
   {
-    std::ofstream* pSaveFile;     //save decoded flow data in this file
     bool           IsAllDecoded;  //Is all flow decoded,(all flow_cnt == 0)
     unsigned       numFlow;       //Num of decoded flows
     FlowInfo_t     decodedFlowInfo;
     
-    Stat_t() : pSaveFile(NULL), IsAllDecoded(true), numFlow(0)
+    explicit Stat_t(const FlowInfo_t::allocator_type& alloc = FlowInfo_t::allocator_type())
+      : IsAllDecoded(true), numFlow(0), decodedFlowInfo(alloc)
     {}
     
   };
 
 
-  typedef std::map<int, Stat_t>                               SWStat_t;
+  /* Dense, indexed by swID - m_numHost
+   */
+  typedef std::vector<Stat_t>                                 SWStat_t;
 
-  typedef boost::unordered_set<FlowField, FlowFieldBoostHash> FlowSet_t;
+  typedef boost::unordered_set<FlowField, FlowFieldBoostHash, std::equal_to<FlowField>,
+			       TrackingAllocator<FlowField> > FlowSet_t;
+
+  /* Get encoder by swID, O(1)
+   */
+  Ptr<FlowEncoder>  GetEncoderByID(int swID) const
+  {
+    return m_encoderByID[swID - m_numHost];
+  }
 
-  /* Get encoder by swID
+  /* Get the switch's status in this frame by swID, O(1)
    */
-  Ptr<FlowEncoder>  GetEncoderByID(int swID);
+  Stat_t&           GetStat(int swID)
+  {
+    return m_swStat[swID - m_numHost];
+  }
 
   /*Initialize each decoding switch's status in the current decoding frame.*/
   void StatInit();
@@ -106,14 +131,31 @@ private:
    */
   void WorkerThread();
 
-  /*Output*/
+  /*Output to the result file*/
   void OutputOriginalCounter();
   /*Output the real flows, directly measured at encoder*/
   void OutputRealFlows();
-  /*Output the flows decoded by flowradar */
+  /*Output the flows decoded by flowradar and their packet cnts*/
   void OutputDecodeInfo();
+
+  /* Save the encoders of the period before it is decoded
+   */
+  void Checkpoint();
+
+  /* The result file is opened at the first output, a restored run does not
+   * overwrite the result of the saving run
+   */
+  Ptr<DecodeResultWriter> GetWriter();
   
   std::vector<Ptr<FlowEncoder> >  m_encoders;
+  /* m_encoders indexed by swID - m_numHost
+   */
+  std::vector<Ptr<FlowEncoder> >  m_encoderByID;
+  int                             m_numHost;
+
+  /* The decoded flows of all switches, declared before the charged containers
+   */
+  MemAccount_t                    m_memAccount;
 
   /* Flow decoded on single swtches in this frame
   SWFlowInfo_t                    m_curSWFlowInfo;
@@ -129,6 +171,22 @@ private:
   
   Ptr<DCTopology>                 m_topo;
 
+  /* Check the decoded flows against the encoders' real flows
+   */
+  AccuracyChecker                 m_checker;
+
+  /* fr-result.dcr, see DecodeResultReader::ConvertToText
+   */
+  Ptr<DecodeResultWriter>         m_writer;
+
+  /* Checkpoint every CHECKPOINT_PERIODS periods, see Restore
+   */
+  Ptr<CheckpointSaver>            m_saver;
+  uint64_t                        m_numDecode;   //periods decoded
+  double                          m_resumeTime;  //the restored checkpoint time, 0 if not restored
+  bool                            m_restored;    //the next period is the restored one, it is not saved again
+  EventId                         m_firstDecode;
+
   /* mutex protected work queue for multi-threads
    */
   WorkQueue<Ptr<FlowEncoder> >    m_workQueue;
@@ -2,10 +2,13 @@
 #include <cmath>
 #include <cstring>
 #include <cstdlib>
+#include <sstream>
 
 #include "flow-encoder.h"
 #include "openflow-switch-net-device.h"
 #include "flow-hash.h"
+#include "radar-checkpoint.h"
+#include "stage-timer.h"
 
 #include "ns3/log.h"
 #include "ns3/udp-l4-protocol.h"
@@ -20,8 +23,12 @@ NS_OBJECT_ENSURE_REGISTERED(FlowEncoder);
 
 unsigned FlowEncoder::m_nextSeed = 0;
   
-FlowEncoder::FlowEncoder() : m_packetReceived(0)
+FlowEncoder::FlowEncoder()
+  : m_countTable(CountTable_t::allocator_type(m_memAccount.GetCounter(MEM_COUNT_TABLE))),
+    m_realFlowCounter(FlowInfo_t::allocator_type(m_memAccount.GetCounter(MEM_REAL_FLOWS))),
+    m_packetReceived(0)
 {
+  m_memAccount.Charge(MEM_FLOW_FILTER, sizeof(FlowFilter_t));
   Clear();
   for( int ithSeed = 0; ithSeed < NUM_COUNT_HASH; ++ithSeed )
     {
@@ -39,6 +46,12 @@ FlowEncoder::SetOFSwtch (Ptr<NetDevice> OFswtch, int id)
   NS_LOG_FUNCTION(this);
 
   m_id = id;
+  m_memAccount.SetOwner(id);
+
+  std::stringstream ss;
+  ss << "sw-" << m_id << ".fr-encoder.";
+  m_packetsMetric  = RadarMetrics::RegisterCounter(ss.str() + "packets");
+  m_newFlowsMetric = RadarMetrics::RegisterCounter(ss.str() + "new-flows");
   
   OFswtch->SetPromiscReceiveCallback(MakeCallback(&FlowEncoder::ReceiveFromOpenFlowSwtch, this));
 
@@ -94,6 +107,7 @@ FlowEncoder::ReceiveFromOpenFlowSwtch(Ptr<NetDevice> ofswtch,
 				      const Address& src, const Address& dst,
 				      NetDevice::PacketType packetType)
 {
+  STAGE_TIMER(STAGE_ENCODER_RECEIVE);
   NS_LOG_INFO("FlowEncoder ID " <<m_id);
   
   Ptr<Packet> packet    = constPacket->Copy();
@@ -101,15 +115,18 @@ FlowEncoder::ReceiveFromOpenFlowSwtch(Ptr<NetDevice> ofswtch,
   FlowField   flow      = FlowFieldFromPacket (packet, protocol);
   NS_LOG_INFO(flow);
   bool        isNewFlow = UpdateFlowFilter (flow);   
-  if (isNewFlow) NS_LOG_INFO("New flow");
+  if (isNewFlow)
+    {
+      NS_LOG_INFO("New flow");
+      RadarMetrics::Add(m_newFlowsMetric);
+    }
   UpdateCountTable (flow, isNewFlow);
 
   /*Update real flow counter for checking*/
   UpdateRealFlowCounter (flow);
 
-  if( ++m_packetReceived % 1000 == 0 )
-    std::cout << "FlowEncoder " << m_id << " received packets "
-	      << m_packetReceived << std::endl; 
+  ++m_packetReceived;
+  RadarMetrics::Add(m_packetsMetric);
   
   return true;
 }
@@ -124,6 +141,51 @@ FlowEncoder::Clear()
   m_realFlowCounter.clear();
 }
 
+void
+FlowEncoder::Save(CheckpointOut& out) const
+{
+  out.Put(m_id);
+  out.PutVector(m_seeds);
+  out.PutVector(m_countTable);
+  out.Put((uint64_t)m_realFlowCounter.size());
+  for(FlowInfo_t::const_iterator it = m_realFlowCounter.begin();
+      it != m_realFlowCounter.end(); ++it)
+    {
+      out.Put(it->first);
+      out.Put(it->second);
+    }
+  out.Put(m_packetReceived);
+}
+
+void
+FlowEncoder::Restore(CheckpointIn& in)
+{
+  int id;
+  in.Get(id);
+  if(id != m_id)
+    NS_FATAL_ERROR("checkpoint of FlowEncoder " << id << " restored at " << m_id);
+
+  Clear();
+  in.GetVector(m_seeds);
+  in.GetVector(m_countTable);
+  NS_ASSERT(m_countTable.size() == COUNT_TABLE_SIZE);
+
+  //Every flow received is in the real flows, they set the flow filter bits
+  uint64_t numFlow;
+  in.Get(numFlow);
+  m_realFlowCounter.rehash(numFlow);
+  for(uint64_t i = 0; i < numFlow; ++i)
+    {
+      FlowField flow;
+      uint16_t  cnt;
+      in.Get(flow);
+      in.Get(cnt);
+      m_realFlowCounter[flow] = cnt;
+      UpdateFlowFilter(flow);
+    }
+  in.Get(m_packetReceived);
+}
+
 bool
 FlowEncoder::UpdateFlowFilter(const FlowField& flow)
 {
@@ -9,11 +9,15 @@
 
 #include "flow-radar-config.h"
 #include "flow-field.h"
+#include "radar-metrics.h"
+#include "mem-accounting.h"
 
 #include <boost/unordered_map.hpp>
 
 namespace ns3 {
 
+class CheckpointOut;
+class CheckpointIn;
   
 class FlowEncoder : public Object
 {
@@ -60,9 +64,10 @@ public:
     }
   };
 
-  typedef std::vector<CountTableEntry>  CountTable_t;
+  typedef std::vector<CountTableEntry, TrackingAllocator<CountTableEntry> >  CountTable_t;
   /* for real flow */
-  typedef boost::unordered_map<FlowField, uint16_t, FlowFieldBoostHash> FlowInfo_t;
+  typedef boost::unordered_map<FlowField, uint16_t, FlowFieldBoostHash, std::equal_to<FlowField>,
+			       TrackingAllocator<std::pair<const FlowField, uint16_t> > > FlowInfo_t;
   
   /*Initialize the flow filter and count table
    */
@@ -94,6 +99,12 @@ public:
    */
   std::vector<uint32_t> GetCountTableIdx(const FlowField& flow);
 
+  /* Save the seeds, count table and real flows to the checkpoint, restore
+   * them and rebuild the flow filter from the real flows.
+   */
+  void                Save (CheckpointOut& out) const;
+  void                Restore (CheckpointIn& in);
+
   
   /* The call back function for openflow switch net device.
    * When openflow swtich net device receive a new packet(it's ReceiveFromDevice
@@ -130,12 +141,15 @@ private:
   typedef std::bitset<FLOW_FILTER_SIZE> FlowFilter_t;
   
   int                     m_id;             //id of the switch node
+  MemAccount_t            m_memAccount;     //the switch's, declared before the charged containers
   FlowFilter_t            m_flowFilter;     //bit  
   CountTable_t            m_countTable;     //count table
   FlowInfo_t              m_realFlowCounter;
   std::vector<unsigned>   m_seeds;          //CounterTable hash seeds
   static unsigned         m_nextSeed;       //global next seed to add.
   uint64_t                m_packetReceived; //
+  RadarMetrics::MetricId_t m_packetsMetric;  //sw-<id>.fr-encoder.packets
+  RadarMetrics::MetricId_t m_newFlowsMetric; //sw-<id>.fr-encoder.new-flows
 };
 
  
@@ -1,6 +1,8 @@
 #include "flow-field.h"
+#include "flow-hash.h"
 
 #include <iostream>
+#include <cstring>
 
 #include "ns3/udp-l4-protocol.h"
 #include "ns3/tcp-l4-protocol.h"
@@ -63,6 +65,18 @@ bool operator==(FlowField const& f1, FlowField const& f2)
       && f1.ipv4prot  == f2.ipv4prot;
 }
 
+uint32_t FlowFieldHash(const FlowField& flow, uint32_t seed)
+{
+  char buf[13];
+  memcpy(buf     , &(flow.ipv4srcip), 4);
+  memcpy(buf + 4 , &(flow.ipv4dstip), 4);
+  memcpy(buf + 8 , &(flow.srcport)  , 2);
+  memcpy(buf + 10, &(flow.dstport)  , 2);
+  memcpy(buf + 12, &(flow.ipv4prot) , 1);
+
+  return murmur3_32(buf, 13, seed);
+}
+
 FlowField FlowFieldFromPacket(Ptr<Packet> packet, uint16_t protocol)
 {
   NS_LOG_INFO("Extract flow field");
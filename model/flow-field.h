@@ -6,6 +6,7 @@
 #include <boost/functional/hash.hpp>
 #include <boost/unordered_map.hpp>
 #include <vector>
+#include <memory>
 #include "ns3/ptr.h"
 
 namespace ns3
@@ -46,8 +47,16 @@ struct FlowFieldBoostHash
 /*Current compiler do not support c++11 template alias
  *So we just define a new template
  */
-template<class INFO>
-class FlowInfoHashMap_t : public boost::unordered_map<FlowField, INFO, FlowFieldBoostHash> {};
+template<class INFO, class ALLOC = std::allocator<std::pair<const FlowField, INFO> > >
+class FlowInfoHashMap_t
+  : public boost::unordered_map<FlowField, INFO, FlowFieldBoostHash, std::equal_to<FlowField>, ALLOC>
+{
+public:
+  FlowInfoHashMap_t () {}
+  explicit FlowInfoHashMap_t (const ALLOC& alloc)
+    : boost::unordered_map<FlowField, INFO, FlowFieldBoostHash, std::equal_to<FlowField>, ALLOC>(alloc)
+  {}
+};
 
 template<class INFO>
 class FlowInfoVec_t : public std::vector<std::pair<FlowField, INFO> > {};
@@ -73,6 +82,13 @@ struct PckByteCnt
   uint64_t m_byteCnt;
 };
 
+/*The packet and byte cnt of the flow infos, the packet cnt only infos have no bytes
+ */
+inline uint32_t FlowPacketCnt(uint32_t cnt)          { return cnt; }
+inline uint32_t FlowPacketCnt(const PckByteCnt& cnt) { return cnt.m_packetCnt; }
+inline uint64_t FlowByteCnt(uint32_t)                { return 0; }
+inline uint64_t FlowByteCnt(const PckByteCnt& cnt)   { return cnt.m_byteCnt; }
+
 struct PckByteCntByteGreater
 {
   bool operator()(const std::pair<FlowField, PckByteCnt>& x1, 
@@ -100,6 +116,10 @@ bool operator==(FlowField const& f1, FlowField const& f2);
 
 FlowField FlowFieldFromPacket(Ptr<Packet> packet, uint16_t protocol);
 
+/*Seeded murmur3 hash of the flow's 5 tuple, same byte layout as the encoders' hash
+ */
+uint32_t  FlowFieldHash(const FlowField& flow, uint32_t seed);
+
 }
 
 #endif
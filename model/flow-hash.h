@@ -1,11 +1,25 @@
 #ifndef FLOW_HASH_H
 #define FLOW_HASH_H
 
+#include <stdint.h>
+
 namespace ns3
 {
 
 #define ROT32(x, y) ((x << y) | (x >> (32 - y))) // avoid effort
 
+/* The murmur3 finalizer, mixes all bits of h. Used alone to spread a small key,
+ * e.g. the ECMP way of a node and the route table slot of an IP.
+ */
+inline uint32_t fmix32(uint32_t h) {
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
 /* The this function is copied from LossRadar simple_switch.cpp.
  * LossRadar is the same author with FlowRadar.https://github.com/USC-NSL/
  * The orginal code is from wikipedia: https://en.wikipedia.org/wiki/MurmurHash
@@ -52,13 +66,7 @@ inline uint32_t murmur3_32(const char *key, uint32_t len, uint32_t seed) {
 	}
 
 	hash ^= len;
-	hash ^= (hash >> 16);
-	hash *= 0x85ebca6b;
-	hash ^= (hash >> 13);
-	hash *= 0xc2b2ae35;
-	hash ^= (hash >> 16);
-
-	return hash;
+	return fmix32(hash);
 }
 /*
 struct my_hash1 {
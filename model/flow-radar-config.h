@@ -12,6 +12,9 @@ namespace ns3
 
 static const float PERIOD = 1.f;
 static const float END_TIME = 0.f;
+
+static const bool OUTPUT_FLOWS = false; //save the counters, real and decoded flows to fr-result.dcr, the AccuracyChecker checks in memory
+static const size_t CHECKPOINT_PERIODS = 0; //save the encoders every n periods to fr-ckpt-t-<time>.ckpt, 0 disables
   
 static const size_t NUM_THREAD = 4; //4 worker thread for counter lsqr decoding
 
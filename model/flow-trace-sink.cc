@@ -0,0 +1,129 @@
+#include "flow-trace-sink.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/packet.h"
+#include "ns3/node.h"
+#include "ns3/queue.h"
+#include "ns3/csma-net-device.h"
+#include "ns3/ethernet-header.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/udp-l4-protocol.h"
+#include "ns3/tcp-l4-protocol.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("FlowTraceSink");
+
+std::ostream&
+operator<<(std::ostream& os, const FlowActCnt_t& act)
+{
+  os << "+" << act.m_enqueue << "-" << act.m_dequeue << "r" << act.m_rx << "d" << act.m_drop;
+  return os;
+}
+
+FlowTraceSink::FlowTraceSink (uint32_t numNode)
+  : m_nodeCounters(numNode)
+{
+  NS_LOG_FUNCTION(this << numNode);
+}
+
+FlowTraceSink::~FlowTraceSink ()
+{
+}
+
+void
+FlowTraceSink::Install (Ptr<CsmaNetDevice> device)
+{
+  uint32_t nodeID = device->GetNode()->GetId();
+  NS_ASSERT(nodeID < m_nodeCounters.size());
+  NodeCounter_t* counter = &m_nodeCounters[nodeID];
+
+  Ptr<Queue> queue = device->GetQueue();
+  queue->TraceConnectWithoutContext("Enqueue", MakeBoundCallback(&FlowTraceSink::EnqueueSink, counter));
+  queue->TraceConnectWithoutContext("Dequeue", MakeBoundCallback(&FlowTraceSink::DequeueSink, counter));
+  queue->TraceConnectWithoutContext("Drop",    MakeBoundCallback(&FlowTraceSink::DropSink, counter));
+  device->TraceConnectWithoutContext("MacRx",  MakeBoundCallback(&FlowTraceSink::RxSink, counter));
+}
+
+const FlowInfoHashMap_t<FlowActCnt_t>&
+FlowTraceSink::GetNodeFlows (uint32_t nodeID) const
+{
+  return m_nodeCounters[nodeID].m_flows;
+}
+
+bool
+FlowTraceSink::GetFlow (Ptr<const Packet> packet, FlowField& flow)
+{
+  Ptr<Packet>    copy = packet->Copy();
+  EthernetHeader ethHd(false);
+  if(!copy->RemoveHeader(ethHd) || ethHd.GetLengthType() != Ipv4L3Protocol::PROT_NUMBER)
+    return false;
+
+  flow = FlowFieldFromPacket(copy, Ipv4L3Protocol::PROT_NUMBER);
+  return flow.ipv4prot == TcpL4Protocol::PROT_NUMBER || flow.ipv4prot == UdpL4Protocol::PROT_NUMBER;
+}
+
+void
+FlowTraceSink::EnqueueSink (NodeCounter_t* counter, Ptr<const Packet> packet)
+{
+  FlowField flow;
+  if(GetFlow(packet, flow))
+    ++counter->m_flows[flow].m_enqueue;
+}
+
+void
+FlowTraceSink::DequeueSink (NodeCounter_t* counter, Ptr<const Packet> packet)
+{
+  FlowField flow;
+  if(GetFlow(packet, flow))
+    ++counter->m_flows[flow].m_dequeue;
+}
+
+void
+FlowTraceSink::DropSink (NodeCounter_t* counter, Ptr<const Packet> packet)
+{
+  FlowField flow;
+  if(GetFlow(packet, flow))
+    ++counter->m_flows[flow].m_drop;
+}
+
+void
+FlowTraceSink::RxSink (NodeCounter_t* counter, Ptr<const Packet> packet)
+{
+  FlowField flow;
+  if(GetFlow(packet, flow))
+    ++counter->m_flows[flow].m_rx;
+}
+
+void
+FlowTraceSink::Output () const
+{
+  for(size_t nid = 0; nid < m_nodeCounters.size(); ++nid)
+    {
+      const FlowInfoHashMap_t<FlowActCnt_t>& flows = m_nodeCounters[nid].m_flows;
+      if(flows.empty())
+	continue;
+
+      std::stringstream ss;
+      ss << "sw-" << nid << "-real.txt";
+      std::string filename; ss >> filename;
+
+      std::ofstream file(filename.c_str());
+      NS_ASSERT( file.is_open() );
+      for(FlowInfoHashMap_t<FlowActCnt_t>::const_iterator it = flows.begin();
+	  it != flows.end();
+	  ++it)
+	{
+	  file << it->first << " " << it->second.GetPacketCnt() << " " << it->second << std::endl;
+	}
+      file.close();
+      NS_LOG_INFO("Node " << nid << " flows save at " << filename);
+    }
+}
+
+}
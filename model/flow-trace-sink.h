@@ -0,0 +1,83 @@
+#ifndef FLOW_TRACE_SINK_H
+#define FLOW_TRACE_SINK_H
+
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+
+#include "flow-field.h"
+
+#include <vector>
+
+namespace ns3
+{
+
+class Packet;
+class CsmaNetDevice;
+
+/* The actions of a flow's packets at a node, as in the ascii trace(+ - r d)
+ */
+struct FlowActCnt_t
+{
+  FlowActCnt_t() : m_enqueue(0), m_dequeue(0), m_rx(0), m_drop(0)
+  {}
+
+  /* The packets sent to the node's queues(enqueued or dropped)
+   */
+  uint32_t GetPacketCnt() const { return m_enqueue + m_drop; }
+
+  uint32_t m_enqueue;
+  uint32_t m_dequeue;
+  uint32_t m_rx;
+  uint32_t m_drop;
+};
+
+std::ostream& operator<<(std::ostream& os, const FlowActCnt_t& act);
+
+/* Ground truth flow packet counts of each node, the ascii trace(packet.tr)
+ * parsed by CheckScript/packet-parser.py without the trace file.
+ * The sink is connected to the csma devices' queue Enqueue/Dequeue/Drop and MacRx
+ * traces, the flow of a traced packet is counted at the device's node.
+ */
+class FlowTraceSink : public Object
+{
+public:
+  FlowTraceSink (uint32_t numNode);
+  virtual ~FlowTraceSink ();
+
+  /* Connect to the device's traces, install it after the device's queue is set
+   */
+  void Install (Ptr<CsmaNetDevice> device);
+
+  const FlowInfoHashMap_t<FlowActCnt_t>& GetNodeFlows (uint32_t nodeID) const;
+
+  /* Output the flows of each node into sw-<nodeID>-real.txt,
+   * the same lines as packet-parser.py: flow pcnt acts
+   */
+  void Output () const;
+
+private:
+  FlowTraceSink(const FlowTraceSink&);
+  FlowTraceSink& operator=(const FlowTraceSink&);
+
+  /* The traces of a node are bound to its counter
+   */
+  struct NodeCounter_t
+  {
+    FlowInfoHashMap_t<FlowActCnt_t> m_flows;
+  };
+
+  static void EnqueueSink (NodeCounter_t* counter, Ptr<const Packet> packet);
+  static void DequeueSink (NodeCounter_t* counter, Ptr<const Packet> packet);
+  static void DropSink    (NodeCounter_t* counter, Ptr<const Packet> packet);
+  static void RxSink      (NodeCounter_t* counter, Ptr<const Packet> packet);
+
+  /* The flow of the ethernet frame, false if it's not a TCP UDP packet
+   */
+  static bool GetFlow (Ptr<const Packet> packet, FlowField& flow);
+
+  std::vector<NodeCounter_t>  m_nodeCounters;   //idx is the node id
+};
+
+}
+
+#endif
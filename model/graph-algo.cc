@@ -1,38 +1,58 @@
 
 #include <iostream>
-#include <queue>
 #include <algorithm>
-#include <cstdlib>
 
 #include "graph-algo.h"
 
 #include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/system-thread.h"
 
 NS_LOG_COMPONENT_DEFINE("Graph");
 
 namespace ns3 {
 
-/*Use Dijkstra algorithm to calculate the shortest path 
- *and store each node's path to its path table;
+const Graph::Dist_t Graph::UNREACHABLE;
+const uint32_t     Graph::NO_PATH;
+
+/*Use BFS from every node to calculate the hop distance of all pairs,
+ *the shortest paths are recovered from the dist table;
  */
 
-Graph::Graph() 
+Graph::Graph()
+  : m_adjOffset(TrackingAllocator<unsigned>(m_memAccount.GetCounter(MEM_GRAPH))),
+    m_adjNodes(TrackingAllocator<AdjNode_t>(m_memAccount.GetCounter(MEM_GRAPH))),
+    m_dist(TrackingAllocator<Dist_t>(m_memAccount.GetCounter(MEM_GRAPH))),
+    m_numNodes(0), m_numHost(0),
+    m_pairRows(TrackingAllocator<IdxVec_t>(m_memAccount.GetCounter(MEM_PATH_CACHE))),
+    m_wayIdx(TrackingAllocator<uint32_t>(m_memAccount.GetCounter(MEM_PATH_CACHE))),
+    m_edgeArena(TrackingAllocator<Edge_t>(m_memAccount.GetCounter(MEM_PATH_CACHE)))
 {
-  std::srand(0x2BAD);  //ensure same path in each simulation
 }
 
 void
-Graph::SetAdjList(const AdjList_t& adjList)
+Graph::SetAdjList(const AdjList_t& adjList, int numHost)
 {
-  m_adjList = adjList;
   m_numNodes = adjList.size();
-  //Prepare the path table's size
-  m_paths.resize (m_numNodes);
+  m_numHost  = numHost;
+
+  //Flatten the adj list into CSR
+  m_adjOffset.resize (m_numNodes + 1);
+  m_adjNodes.clear ();
   for(int i = 0; i < m_numNodes; i++)
     {
-      m_paths[i].resize(m_numNodes);
-      m_paths[i][i].dist = 0;
+      m_adjOffset[i] = m_adjNodes.size();
+      m_adjNodes.insert(m_adjNodes.end(), adjList[i].begin(), adjList[i].end());
     }
+  m_adjOffset[m_numNodes] = m_adjNodes.size();
+
+  //Prepare the dist table's size
+  m_dist.assign ((size_t)m_numNodes * m_numNodes, UNREACHABLE);
+
+  //Prepare the empty rows of the path index, the paths are generated on demand
+  m_pairRows.assign (m_numHost, IdxVec_t(TrackingAllocator<uint32_t>(m_memAccount.GetCounter(MEM_PATH_CACHE))));
+  m_wayIdx.clear ();
+  m_edgeArena.clear ();
 
   BuildPaths ();
 }
@@ -41,192 +61,179 @@ void
 Graph::BuildPaths ()
 {
   NS_LOG_FUNCTION(this);
-  
-  for(int i = 0; i < m_numNodes; ++i)
+
+  NS_ASSERT(m_bfsWork.IsEmpty());
+  for(int i = 0; i < m_numNodes; i += BFS_ROOT_CHUNK)
     {
-      //Dijkstra(i);
-      BFS(i);
+      m_bfsWork.PutWork(i);
     }
-}
-  
-Graph::Path_t
-Graph::GetPath (int from, int to) const
-{
 
-  int key = from * 100 + to; //Hacking!!
-  if(m_pathCache.find(key) == m_pathCache.end())
+  //Each thread writes its own rows of the dist table, no lock needed.
+  std::vector<Ptr<SystemThread> > bfsThreads;
+  for(size_t ith = 0; ith < NUM_BFS_THREAD; ++ith)
     {
-        const PathTable_t & pathTable = m_paths[from];
-        Path_t        path;
-
-	int before;
-	for(int i = to; i != from; i = before)
-	  {
-	    Edge_t    edge;
-	    unsigned randomIth = std::rand() % pathTable[i].before.size();
-	    //unsigned randomIth = ++m_seed % pathTable[i].before.size();
-	    //std::cout << randomIth << std::endl;
-	    before = pathTable[i].before[randomIth];
-	    edge.src = before;
-	    edge.dst = i;
-
-	    const AdjListEntry_t & adjNodes = m_adjList[edge.src];
-	    AdjNode_t dstNode;
-	    //find the dst node in src's adjlist
-	    for (unsigned adjid = 0; adjid < adjNodes.size(); ++adjid)
-	      {
-		if ( adjNodes[adjid].id == edge.dst )
-		  {
-		    dstNode = adjNodes[adjid];
-		    break;
-		  }
-	      }
-      
-	    edge.spt = dstNode.from_port;
-	    edge.dpt = dstNode.to_port;
-
-	    path.push_back (edge); 
-	  }
-
-	//reverse the path;
-	Path_t pathRev;
-	for(int i = path.size() - 1; i >= 0; --i)
-	  {
-	    pathRev.push_back( path[i] );
-	  }
-
-	m_pathCache[key] = pathRev;
+      Ptr<SystemThread> bfsThread
+	= Create<SystemThread>( MakeCallback(&Graph::BFSWorker, this) );
+      bfsThread->Start();
+      bfsThreads.push_back (bfsThread);
+    }
 
+  for(size_t ith = 0; ith < bfsThreads.size(); ++ith)
+    {
+      bfsThreads[ith]->Join();
     }
 
-  return m_pathCache[key];
-  
+  NS_LOG_INFO("BFS from " << m_numNodes << " nodes finished");
 }
 
-
 void
-Graph::BFS (int root)
+Graph::BFSWorker ()
 {
-  PathTable_t& pathTable = m_paths[root];
-  pathTable[root].known = true;
-   
-  std::queue<int>   curLayer;
-  std::vector<int>  nextLayer;
-  curLayer.push(root);
-
-  while(!curLayer.empty())
+  std::vector<uint64_t> visited ((m_numNodes + 63) / 64);
+  std::vector<int>      curLayer;
+  std::vector<int>      nextLayer;
+  curLayer.reserve (m_numNodes);
+  nextLayer.reserve (m_numNodes);
+
+  int first;
+  while( m_bfsWork.TryGetWork(first) )
     {
-      int cur = curLayer.front();
-      curLayer.pop();
-
-      
-      const AdjListEntry_t& curAdj = m_adjList[cur];
-      for(unsigned i = 0; i < curAdj.size(); ++i)
+      int last = std::min(first + (int)BFS_ROOT_CHUNK, m_numNodes);
+      for(int root = first; root < last; ++root)
 	{
-	  int adjID = curAdj[i].id;
-	  
-	  //Add adj nodes to the next layer.
-
-	  if(!pathTable[adjID].known)
-	    {
-	      pathTable[adjID].before.push_back(cur);
-	      
-	      if(std::find(nextLayer.begin(), nextLayer.end(), adjID)
-		 ==nextLayer.end())
-		{
-		  nextLayer.push_back(adjID);
-		}
-	    }
-	  
+	  BFS(root, visited, curLayer, nextLayer);
 	}
+    }
+}
+
+uint32_t&
+Graph::GetPathOffset (int from, int to, unsigned way) const
+{
+  IdxVec_t& row = m_pairRows[from];
+  if(row.empty())
+    row.assign (m_numHost, NO_PATH);
+
+  uint32_t& block = row[to];
+  if(block == NO_PATH)
+    {
+      block = m_wayIdx.size();
+      m_wayIdx.resize (block + ECMP_NUM_WAYS, NO_PATH);
+    }
+  return m_wayIdx[block + way];
+}
+
+Graph::Path_t
+Graph::GetPath (int from, int to, uint32_t flowHash) const
+{
+  NS_ASSERT(from < m_numHost && to < m_numHost);
 
-      if(curLayer.empty())
+  unsigned  way    = EcmpWay(flowHash);
+  Dist_t    dist   = GetDist(to, from);
+  uint32_t& offset = GetPathOffset(from, to, way);
+  if(offset == NO_PATH)
+    {
+      NS_ASSERT_MSG(dist != UNREACHABLE, "No path from " << from << " to " << to);
+
+      //Append the path to the arena, walk from from to to hop by hop.
+      offset = m_edgeArena.size();
+      m_edgeArena.resize (offset + dist);
+      Edge_t* path = &m_edgeArena[offset];
+      int     i    = from;
+      for(Dist_t d = dist; d > 0; --d)
 	{
+	  //i's next hops are the adj nodes one hop closer to to
+	  unsigned        begin     = m_adjOffset[i];
+	  unsigned        end       = m_adjOffset[i + 1];
+	  unsigned        numHops   = 0;
+	  for(unsigned adj = begin; adj < end; ++adj)
+	    {
+	      if( GetDist(to, m_adjNodes[adj].id) == d - 1 ) ++numHops;
+	    }
+	  NS_ASSERT(numHops > 0);
 
-	  for(unsigned ith = 0; ith < nextLayer.size(); ++ith)
+	  unsigned ith = EcmpSelect(way, i, numHops);
+	  unsigned adj = begin;
+	  for(;; ++adj)
 	    {
-	      curLayer.push(nextLayer[ith]);
-	      pathTable[nextLayer[ith]].known = true;
+	      if( GetDist(to, m_adjNodes[adj].id) == d - 1
+		  && ith-- == 0 )
+		break;
 	    }
 
-	  nextLayer.clear();
+	  //the adj node is i -> next, so is the edge
+	  const AdjNode_t& nextNode = m_adjNodes[adj];
+	  Edge_t& edge = path[dist - d];
+	  edge.src = i;
+	  edge.dst = nextNode.id;
+	  edge.spt = nextNode.from_port;
+	  edge.dpt = nextNode.to_port;
+
+	  i = nextNode.id;
 	}
-      
+
     }
 
-  /*
-    for(unsigned i = 0; i < pathTable.size(); i++)
-      {
-	std::cout << i << ":  ";
-	for(unsigned j = 0; j < pathTable[i].before.size(); ++j)
-	  {
-	    std::cout << pathTable[i].before[j] << " ";
-	  }
-	std::cout << std::endl;
-      }
-  */
+  return Path_t(&m_edgeArena, offset, dist);
 
 }
-  
-/*
+
 void
-Graph::Dijkstra(int root)
+Graph::GetNextHopPorts (int node, int to, std::vector<uint16_t>& ports) const
 {
-  //NS_LOG_LOGIC (i << " path table");
-  PathTable_t& pathTable = m_paths[root];
-  while(1)
-    {
-      //next node to add into the known set; 
-      int next = FindSmallestUnknown (pathTable);
-      if( next  == -1 )
-	{
-	  break;
-	}
-	
-      pathTable[next].known = true;
+  ports.clear();
 
-      //for each next's adjcent node.
-      for(unsigned i = 0; i < m_adjList[next].size(); ++i)
-	{
-	  int adj    = m_adjList[next][i].id;
-	  int weight = m_adjList[next][i].weight;
-	    
-	  if ( pathTable[next].dist + weight < pathTable[adj].dist)
-	    {
-	      pathTable[adj].before = next;
-	      pathTable[adj].dist = pathTable[next].dist + weight;
-	    }
-	}
-    }
+  Dist_t dist = GetDist(to, node);
+  if(dist == 0 || dist == UNREACHABLE)
+    return;
 
-  
-  for(unsigned i = 0; i < pathTable.size(); i++)
+  for(unsigned adj = m_adjOffset[node]; adj < m_adjOffset[node + 1]; ++adj)
     {
-      std::cout << i <<" K "<< pathTable[i].known << " D " << pathTable[i].dist
-		<<" B "<< pathTable[i].before << std::endl;
+      if( GetDist(to, m_adjNodes[adj].id) == dist - 1 )
+	ports.push_back(m_adjNodes[adj].from_port);
     }
-  
 }
-*/
 
-int
-Graph::FindSmallestUnknown(PathTable_t& pathTable)
+
+void
+Graph::BFS (int root, std::vector<uint64_t>& visited,
+	    std::vector<int>& curLayer, std::vector<int>& nextLayer)
 {
-  int v;
-  int dist_s = MAX_DIST;
-  for (unsigned i = 0; i < pathTable.size(); ++i)
+  Dist_t* dist = &m_dist[(size_t)root * m_numNodes];
+
+  std::fill(visited.begin(), visited.end(), 0);
+  visited[root >> 6] |= (uint64_t)1 << (root & 63);
+  dist[root] = 0;
+
+  curLayer.clear();
+  curLayer.push_back(root);
+
+  for(Dist_t d = 1; !curLayer.empty(); ++d)
     {
-      if( !pathTable[i].known &&  pathTable[i].dist < dist_s )
+      nextLayer.clear();
+      for(size_t ith = 0; ith < curLayer.size(); ++ith)
 	{
-	  v = i;
-	  dist_s = pathTable[i].dist;
+	  int cur = curLayer[ith];
+
+	  //Add unvisited adj nodes to the next layer.
+	  for(unsigned adj = m_adjOffset[cur]; adj < m_adjOffset[cur + 1]; ++adj)
+	    {
+	      int      adjID = m_adjNodes[adj].id;
+	      uint64_t bit   = (uint64_t)1 << (adjID & 63);
+	      if(visited[adjID >> 6] & bit)
+		continue;
+
+	      NS_ABORT_MSG_IF(d == UNREACHABLE, "Graph is too deep for the dist table");
+	      visited[adjID >> 6] |= bit;
+	      dist[adjID] = d;
+	      nextLayer.push_back(adjID);
+	    }
 	}
+
+      curLayer.swap(nextLayer);
     }
 
-  if (dist_s == MAX_DIST) return -1;
-  return v;
 }
-  
+
 Graph::~Graph()
 {
   NS_LOG_LOGIC(this);
@@ -234,5 +241,5 @@ Graph::~Graph()
 
 
 
-  
+
 }
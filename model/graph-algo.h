@@ -4,14 +4,31 @@
 #include <stdint.h>
 #include <limits>
 #include <vector>
-#include <list>
-#include <map>
+
+#include "work-queue.h"
+#include "flow-hash.h"
+#include "mem-accounting.h"
 
 namespace ns3 {
 
+/* All pairs BFS config
+ * BuildPaths splits the BFS roots into chunks of BFS_ROOT_CHUNK roots,
+ * NUM_BFS_THREAD worker threads take the chunks from a work queue.
+ */
+static const size_t   NUM_BFS_THREAD = 4;
+static const unsigned BFS_ROOT_CHUNK = 64;
+
+/* ECMP config
+ * A flow's 5 tuple hash (seeded with ECMP_HASH_SEED) picks one of the
+ * ECMP_NUM_WAYS ways of its host pair. Each way chooses one of the equal
+ * cost next hops at every node on the path.
+ */
+static const unsigned ECMP_NUM_WAYS  = 8;
+static const uint32_t ECMP_HASH_SEED = 0x2BAD;
+
 class Graph
 {
-  
+
 public:
   /*The Adjacent List Node;
    */
@@ -25,77 +42,139 @@ public:
     AdjNode_t():from_port(0), to_port(0), id(0), weight(0)
     {}
 
-    
+
   };
   typedef std::vector<AdjNode_t>       AdjListEntry_t;
   typedef std::vector<AdjListEntry_t>  AdjList_t;
 
-  /*PathTable Entry Type
+  /*Hop distance from a BFS root to a node. One byte per (root, node) pair,
+   *the all pairs table takes N*N bytes.
    */
-#define MAX_DIST std::numeric_limits<int>::max()
-  
-  struct PathTableEntry_t
-  {
-    PathTableEntry_t():
-      known(false),
-      dist(MAX_DIST)
-    {
-    }
-    bool known;
-    int  dist;
-    std::vector<int>  before;
-  };
-  typedef std::vector<PathTableEntry_t>  PathTable_t;
+  typedef uint8_t Dist_t;
+  static const Dist_t UNREACHABLE = 0xff;
 
-  struct Edge_t 
+  struct Edge_t
   {
     int src;
     int dst;
     uint16_t spt;
     uint16_t dpt;
   };
+  typedef std::vector<Edge_t, TrackingAllocator<Edge_t> > EdgeArena_t;
 
-  typedef std::vector<Edge_t> Path_t;
+  /*A lightweight view of a path in the edge arena. It keeps the arena
+   *offset instead of a pointer, so it stays valid when the arena grows.
+   */
+  class Path_t
+  {
+  public:
+    Path_t () : m_arena(0), m_offset(0), m_size(0)
+    {}
+    Path_t (const EdgeArena_t* arena, uint32_t offset, uint32_t size)
+      : m_arena(arena), m_offset(offset), m_size(size)
+    {}
+
+    size_t        size  () const { return m_size; }
+    bool          empty () const { return m_size == 0; }
+    const Edge_t& operator[] (size_t i) const { return (*m_arena)[m_offset + i]; }
+
+  private:
+    const EdgeArena_t* m_arena;
+    uint32_t           m_offset;
+    uint32_t           m_size;
+  };
 
   Graph();
   ~Graph();
 
-  Path_t  GetPath (int from, int to) const;
+  /*Get the ECMP path of a flow from host from to host to, flowHash is the
+   *flow's 5 tuple hash. O(1) after the first call of the (from, to, way),
+   *no allocation except the lazy path index and the amortized growth of the
+   *edge arena.
+   */
+  Path_t  GetPath (int from, int to, uint32_t flowHash) const;
+
+  /*The ports of node's equal cost next hops to node to, in adjacency order.
+   *EcmpSelect on these ports picks the same next hop GetPath does.
+   */
+  void    GetNextHopPorts (int node, int to, std::vector<uint16_t>& ports) const;
+
+  static unsigned EcmpWay (uint32_t flowHash)
+  {
+    return flowHash % ECMP_NUM_WAYS;
+  }
+
+  /*Pick one of the numHops next hops at node for the way. The way is mixed
+   *with the node id so the switches of a path choose independently.
+   */
+  static unsigned EcmpSelect (unsigned way, int node, unsigned numHops)
+  {
+    return fmix32(way * 0x9e3779b1 ^ (uint32_t)node) % numHops;
+  }
 
-  void BFS (int root);
+  /*The first numHost nodes are the hosts, the paths are indexed between them.
+   */
+  void SetAdjList(const AdjList_t& adjList, int numHost);
 
-  void SetAdjList(const AdjList_t& adjList);
-  
 private:
 
-  /*Build all nodes' Path table.
+  /*Build all nodes' dist table rows, BFS from every node in parallel.
    */
   void BuildPaths();
 
-  /*Find all shortest path
+  /*Worker thread of BuildPaths, run BFS on the root chunks in m_bfsWork
    */
-  
-  
-  /*Use Dijkstra algo to compute the short path from node root to other nodes, 
-   *store the paths in root's path table.
+  void BFSWorker();
+
+  /*BFS from root, fill root's row of the dist table.
+   *visited, curLayer and nextLayer are the worker's scratch buffers,
+   *a node enters the next layer only once, checked by its visited bit.
    */
-  /*
-  void Dijkstra (int root);
-  */
+  void BFS (int root, std::vector<uint64_t>& visited,
+	    std::vector<int>& curLayer, std::vector<int>& nextLayer);
 
-  /*Find the unknown node in root's pathTable with the shortest smallest dist,
-   *If the founded unknown node's dist == MAX_DIST, we'll say that this node is 
-   *not exist.
+  Dist_t GetDist (int root, int node) const
+  {
+    return m_dist[(size_t)root * m_numNodes + node];
+  }
+
+  MemAccount_t             m_memAccount;  //shared by the controller and the decoders
+
+  /*CSR adjacency: the adj nodes of node i are
+   *m_adjNodes[m_adjOffset[i], m_adjOffset[i + 1]).
+   *
+   *The BFS predecessors are not stored. The predecessors of node i from
+   *root are i's adj nodes with GetDist(root, adj) == GetDist(root, i) - 1,
+   *so the CSR adjacency and the dist table are the predecessor table.
    */
-  int  FindSmallestUnknown (PathTable_t& pathTable);
-  
-  AdjList_t                m_adjList;
-  std::vector<PathTable_t> m_paths;
+  std::vector<unsigned, TrackingAllocator<unsigned> >   m_adjOffset;
+  std::vector<AdjNode_t, TrackingAllocator<AdjNode_t> > m_adjNodes;
+  std::vector<Dist_t, TrackingAllocator<Dist_t> >       m_dist;      //m_numNodes * m_numNodes, row per root
   int                      m_numNodes;
-  mutable std::map<int, Path_t>    m_pathCache;
-  //Path cache, the first time we GetPath(in easy controller),
-  //the Path is generated randomly.
-  //Then the cache is stored to ensured consistent.(is the same in FlowDecoder)
+  int                      m_numHost;
+  WorkQueue<int>           m_bfsWork;   //first root of each chunk
+
+  /*Path cache, the path of a (from, to, way) is generated the first time
+   *it is asked for(by the easy controller or the FlowDecoder).
+   *
+   *The index is filled lazily, a host pair costs nothing before its first path.
+   *m_pairRows[from] is the row of from's m_numHost pairs, allocated at from's
+   *first path. A pair's entry is the offset of its block of ECMP_NUM_WAYS path
+   *offsets in m_wayIdx, appended at the pair's first path. A path offset is the
+   *offset of the path in m_edgeArena. Both are NO_PATH if not generated yet.
+   *The path length is the hop distance, so only the offset is stored.
+   */
+  typedef std::vector<uint32_t, TrackingAllocator<uint32_t> > IdxVec_t;
+
+  /*The path offset of (from, to, way), NO_PATH if the path is not generated yet.
+   *The row and the way block are allocated here if they are not yet.
+   */
+  uint32_t& GetPathOffset (int from, int to, unsigned way) const;
+
+  static const uint32_t                                        NO_PATH = 0xffffffff;
+  mutable std::vector<IdxVec_t, TrackingAllocator<IdxVec_t> >  m_pairRows;
+  mutable IdxVec_t                                             m_wayIdx;
+  mutable EdgeArena_t                                          m_edgeArena;
 };
 
 }
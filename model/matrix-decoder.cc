@@ -1,11 +1,12 @@
 #include "matrix-decoder.h"
 #include "matrix-encoder.h"
+#include "stage-timer.h"
 
 #include "ns3/log.h"
 #include "ns3/simulator.h"
 
-#include <fstream>
 #include <utility>
+#include <sstream>
 
 
 namespace ns3 {
@@ -14,6 +15,11 @@ NS_LOG_COMPONENT_DEFINE("MatrixDecoder");
 NS_OBJECT_ENSURE_REGISTERED(MatrixDecoder);
   
 MatrixDecoder::MatrixDecoder()
+  : m_checker("mtx-accuracy.txt"),
+    m_saver(Create<CheckpointSaver>()),
+    m_numDecode(0),
+    m_resumeTime(0.),
+    m_restored(false)
 {}
 
 MatrixDecoder::~MatrixDecoder()
@@ -31,11 +37,22 @@ MatrixDecoder::DecodeFlows()
 {
   NS_LOG_FUNCTION(Simulator::Now().GetSeconds());
 
+  //0. Save the encoders before they are decoded and cleared
+  ++m_numDecode;
+  if(MTX_CHECKPOINT_PERIODS > 0 && m_numDecode % MTX_CHECKPOINT_PERIODS == 0 && !m_restored)
+    Checkpoint();
+  m_restored = false;
+
   //1. Decode flows, if it is offline decode, just output the enooded data.
   for(size_t i = 0; i < m_encoders.size(); ++i)
     {
       MtxDecode(m_encoders[i]);
     }
+  if(!IS_OFFLINE_DECODE)
+    m_checker.EndPeriod();
+
+  //The memory breakdown at the period's peak, before the clear
+  MemAccounting::Report(Simulator::Now().GetSeconds());
   
   //2. Clear all the counters
   for(size_t i = 0; i < m_encoders.size(); ++i)
@@ -73,17 +90,17 @@ MatrixDecoder::MtxDecode(Ptr<MatrixEncoder> target)
 
       FlowInfoVec_t<PckByteCnt> measuredFlowPckByteInfo; 
       DecodeFlowInfoAt(target, measuredFlowPckByteInfo);
-      
-      OutputDecodedFlows(target->GetID(), measuredFlowPckByteInfo);      
+      m_checker.Check(target->GetID(), target->GetRealFlowCounter(), measuredFlowPckByteInfo);
+
+      if(MTX_OUTPUT_FLOWS)
+	OutputDecodedFlows(target->GetID(), measuredFlowPckByteInfo);
       //Notify queue controller to update the queue config according to the measured flow.
+      //Also if no flow is measured, the switch's idle queues are reset to mice only.
       if(!m_decodedCallback.IsNull())
 	{
-	  if(measuredFlowPckByteInfo.size() > 0)
-	    m_decodedCallback(target->GetID(), measuredFlowPckByteInfo);
-	  else 
-	    {
-	      NS_LOG_INFO("No flow measured");
-	    }
+	  if(measuredFlowPckByteInfo.empty())
+	    NS_LOG_INFO("No flow measured");
+	  m_decodedCallback(target->GetID(), measuredFlowPckByteInfo);
 	}
       else
 	{
@@ -92,8 +109,9 @@ MatrixDecoder::MtxDecode(Ptr<MatrixEncoder> target)
      
     }  
 
-  //Output real flows to files
-  OutputRealFlows(target);
+  //Output real flows to files, the offline decoded flows are checked with them
+  if(IS_OFFLINE_DECODE || MTX_OUTPUT_FLOWS)
+    OutputRealFlows(target);
 }
 
 /*Helper function to form the equations
@@ -102,12 +120,13 @@ void FormEquations(const MtxBlock& block,
 		   std::vector<std::vector<uint16_t> >& cntIdToFlowId,
 		   std::vector<uint32_t>& pckCnt,
 		   std::vector<uint32_t>& byteCnt);
-/*Helper function to solve the equations
+/*Helper function to solve the equations with numThreads cplex threads(0 for all the cores)
  *defined in solver/cplex-solve.cc
  */
 void CplexSolveEquations(const std::vector<std::vector<uint16_t> >& cntIdToVarId,
 			 const std::vector<uint32_t>& cnt,
-			 std::vector<uint32_t>& var);
+			 std::vector<uint32_t>& var,
+			 int numThreads);
 void
 MatrixDecoder::DecodeFlowInfoAt(Ptr<MatrixEncoder> target, FlowInfoVec_t<PckByteCnt>& flowPckByteInfo)
 {
@@ -115,26 +134,32 @@ MatrixDecoder::DecodeFlowInfoAt(Ptr<MatrixEncoder> target, FlowInfoVec_t<PckByte
   //For each block, we form the equation and solve, this part can be parallelized 
   for(size_t ib = 0; ib < MTX_NUM_BLOCK; ++ib)
     {
-      const MtxBlock& block   = mtxBlocks[ib];
-      int             flowCnt = block.m_flowTable.size();  //varCnt
-      int             eqCnt   = block.m_countTable.size(); //Equations Cnt
+      DecodeBlock(mtxBlocks[ib], flowPckByteInfo);
+    }
+}
 
-      std::vector<std::vector<uint16_t> > cntIdToFlowId(eqCnt, std::vector<uint16_t>());
-      std::vector<uint32_t>               pckCnt(eqCnt, 0);
-      std::vector<uint32_t>               byteCnt(eqCnt, 0);
-      FormEquations(block, cntIdToFlowId, pckCnt, byteCnt);
+void
+MatrixDecoder::DecodeBlock(const MtxBlock& block, FlowInfoVec_t<PckByteCnt>& flowPckByteInfo,
+			  int cplexThreads)
+{
+  int             flowCnt = block.m_flowTable.size();  //varCnt
+  int             eqCnt   = block.m_countTable.size(); //Equations Cnt
 
-      std::vector<uint32_t> pckSize(flowCnt, 0);   //flow pckSize
-      CplexSolveEquations(cntIdToFlowId, pckCnt, pckSize);
-      std::vector<uint32_t> byteSize(flowCnt, 0);  //flow byteSize
-      CplexSolveEquations(cntIdToFlowId, byteCnt, byteSize);
+  std::vector<std::vector<uint16_t> > cntIdToFlowId(eqCnt, std::vector<uint16_t>());
+  std::vector<uint32_t>               pckCnt(eqCnt, 0);
+  std::vector<uint32_t>               byteCnt(eqCnt, 0);
+  FormEquations(block, cntIdToFlowId, pckCnt, byteCnt);
 
-      for(size_t iFlow = 0; iFlow < block.m_flowTable.size(); ++iFlow)
-	{
-	  const FlowField& flow = block.m_flowTable[iFlow].m_flow;
-	  PckByteCnt       pb(pckSize[iFlow], byteSize[iFlow]);
-	  flowPckByteInfo.push_back( std::make_pair(flow, pb) );
-	}
+  std::vector<uint32_t> pckSize(flowCnt, 0);   //flow pckSize
+  CplexSolveEquations(cntIdToFlowId, pckCnt, pckSize, cplexThreads);
+  std::vector<uint32_t> byteSize(flowCnt, 0);  //flow byteSize
+  CplexSolveEquations(cntIdToFlowId, byteCnt, byteSize, cplexThreads);
+
+  for(size_t iFlow = 0; iFlow < block.m_flowTable.size(); ++iFlow)
+    {
+      const FlowField& flow = block.m_flowTable[iFlow].m_flow;
+      PckByteCnt       pb(pckSize[iFlow], byteSize[iFlow]);
+      flowPckByteInfo.push_back( std::make_pair(flow, pb) );
     }
 }
 
@@ -167,91 +192,37 @@ void FormEquations(const MtxBlock& block,
 void
 MatrixDecoder::OutputFlowSet(Ptr<MatrixEncoder> target)
 {
-  NS_LOG_INFO("Decode at swtch " << target->GetID());
+  STAGE_TIMER(STAGE_OUTPUT);
+  NS_LOG_INFO("Output flow set at swtch " << target->GetID());
 
-  //output file prefix and postfix
-  std::stringstream ss;
-  ss << "s-" << target->GetID() << "-t-" << Simulator::Now().GetSeconds();
-  std::string filenamePre; ss >> filenamePre;
-    
   const std::vector<MtxBlock>& mtxBlocks = target->GetMtxBlocks();
   for(size_t bi = 0 ; bi < mtxBlocks.size(); ++bi)
     {
-      std::stringstream ssb; ssb << "-b-" << bi << ".txt";
-      std::string filenamePost; ssb >> filenamePost;
-      std::string filename = filenamePre + filenamePost; 
-      //NS_LOG_INFO( filename );
-      
-      std::ofstream     file(filename.c_str());
-      NS_ASSERT(file.is_open());
-	
-      const MtxBlock& block = mtxBlocks[bi];
-
-      //1.Output all the flows.
-      file << "flows " << block.m_flowTable.size() << std::endl;
-      for(size_t fi = 0; fi < block.m_flowTable.size(); ++fi)
-	{
-	  //NS_LOG_INFO(mtxflow);
-	  file << block.m_flowTable[fi] << std::endl; 
-	}
-
-      //2.Output counter table
-      file << "counters" << std::endl;
-      for(size_t ci = 0; ci < block.m_countTable.size(); ++ci)
-	{
-	  file << block.m_countTable[ci] << std::endl;
-	}
+      GetWriter()->WriteMtxBlock(target->GetID(), bi, mtxBlocks[bi]);
     }
-
 }
 
  
 void
 MatrixDecoder::OutputRealFlows(Ptr<MatrixEncoder> target)
 {
+  STAGE_TIMER(STAGE_OUTPUT);
   NS_LOG_INFO("Output real flows at sw " << target->GetID());
 
   NS_LOG_INFO("MtxEncoder " << target->GetID() << " Packets Receved "
 	      << target->GetTotalPacketsReceived());
-  
-  std::stringstream ss;
-  ss << "sw-" << target->GetID() << "-t-" << Simulator::Now().GetSeconds()
-     << "-real-flow.txt";
-  std::string filename; ss >> filename;
 
-  std::ofstream file(filename.c_str());
-  NS_ASSERT( file.is_open() );
-  
-  const FlowInfoHashMap_t<PckByteCnt>& realFlows = target->GetRealFlowCounter();
-  for(FlowInfoHashMap_t<PckByteCnt>::const_iterator it = realFlows.begin();
-      it != realFlows.end();
-      ++it )
-    {
-      file << it->first << " " << it->second << std::endl;
-    }
-
-  file.close(); 
+  GetWriter()->WriteFlows(REAL_FLOWS_SECTION, target->GetID(), target->GetRealFlowCounter(),
+		       RESULT_HAS_BYTES);
 }
 
 
 void 
 MatrixDecoder::OutputDecodedFlows(int swID, const FlowInfoVec_t<PckByteCnt>& flows)
 {
+  STAGE_TIMER(STAGE_OUTPUT);
   NS_LOG_INFO("Output decoded flows " << " at sw " << swID); 
-  std::stringstream ss;
-  ss << "sw-" << swID << "-t-" << Simulator::Now().GetSeconds() << "-measured-flow.txt";
-  std::string filename; ss >> filename;
-
-  std::ofstream file(filename.c_str());
-  NS_ASSERT( file.is_open() );
-
-  for(FlowInfoVec_t<PckByteCnt>::const_iterator it = flows.begin();
-      it != flows.end();
-      ++it )
-    {
-      file << it->first << " " << it->second << std::endl;
-    }
-  file.close();
+  GetWriter()->WriteFlows(DECODED_FLOWS_SECTION, swID, flows, RESULT_HAS_BYTES);
 }
   
 void
@@ -259,7 +230,83 @@ MatrixDecoder::Init()
 {
   
   NS_LOG_FUNCTION(this);
-  Simulator::Schedule (Seconds(MTX_PERIOD), &MatrixDecoder::DecodeFlows, this);
+  m_firstDecode = Simulator::Schedule (Seconds(m_restored ? m_resumeTime : MTX_PERIOD),
+				       &MatrixDecoder::DecodeFlows, this);
+  Simulator::ScheduleDestroy (&CheckpointSaver::Wait, m_saver);
+}
+
+Ptr<DecodeResultWriter>
+MatrixDecoder::GetWriter()
+{
+  if(!m_writer)
+    {
+      std::stringstream ss;
+      ss << "mtx-result";
+      if(m_resumeTime > 0.)
+	ss << "-t-" << m_resumeTime;
+      ss << ".dcr";
+      m_writer = Create<DecodeResultWriter>(ss.str());
+      Simulator::ScheduleDestroy (&DecodeResultWriter::Close, m_writer);
+    }
+  return m_writer;
+}
+
+void
+MatrixDecoder::Checkpoint()
+{
+  double now = Simulator::Now().GetSeconds();
+  NS_LOG_FUNCTION(now);
+
+  CheckpointOut      out;
+  CheckpointHeader_t hd;
+  std::memset(&hd, 0, sizeof(hd));
+  std::memcpy(hd.magic, CHECKPOINT_MAGIC, sizeof(hd.magic));
+  hd.radar       = MTX_RADAR_CHECKPOINT;
+  hd.numEncoders = m_encoders.size();
+  hd.time        = now;
+  hd.numDecode   = m_numDecode;
+  out.Put(hd);
+  for(size_t i = 0; i < m_encoders.size(); ++i)
+    {
+      m_encoders[i]->Save(out);
+    }
+
+  std::stringstream ss;
+  ss << "mtx-ckpt-t-" << now << ".ckpt";
+  m_saver->Save(ss.str(), out);
+}
+
+void
+MatrixDecoder::Restore(const std::string& filename)
+{
+  NS_LOG_FUNCTION(filename);
+
+  CheckpointIn       in(filename);
+  CheckpointHeader_t hd;
+  in.Get(hd);
+  if(std::memcmp(hd.magic, CHECKPOINT_MAGIC, sizeof(hd.magic)) != 0 ||
+     hd.radar != MTX_RADAR_CHECKPOINT)
+    NS_FATAL_ERROR("not a mtx radar checkpoint");
+  if(hd.numEncoders != m_encoders.size())
+    NS_FATAL_ERROR("checkpoint has " << hd.numEncoders << " encoders, the topology has " << m_encoders.size());
+
+  for(size_t i = 0; i < m_encoders.size(); ++i)
+    {
+      m_encoders[i]->Restore(in);
+    }
+  NS_ASSERT(in.AtEnd());
+
+  //The restored period is decoded at the checkpoint time and counted again there
+  m_numDecode  = hd.numDecode - 1;
+  m_resumeTime = hd.time;
+  m_restored   = true;
+  if(!m_firstDecode.IsExpired())
+    {
+      m_firstDecode.Cancel();
+      m_firstDecode = Simulator::Schedule (Seconds(m_resumeTime) - Simulator::Now(),
+					   &MatrixDecoder::DecodeFlows, this);
+    }
+  NS_LOG_INFO("Restored " << m_encoders.size() << " encoders at " << m_resumeTime);
 }
 
 void
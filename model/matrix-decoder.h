@@ -2,13 +2,18 @@
 #define MATRIX_DECODER_H
 
 #include "ns3/object.h"
+#include "ns3/event-id.h"
 #include "flow-field.h"
+#include "accuracy-checker.h"
+#include "decode-result.h"
+#include "radar-checkpoint.h"
 #include <string>
 
 namespace ns3 {
 
 class QueueController;  
 class MatrixEncoder;
+struct MtxBlock;
 
 class MatrixDecoder : public Object
 {
@@ -27,6 +32,20 @@ public:
   void Init ();
 
   void SetDecodedCallback(DecodedCallback_t cb);
+
+  /* Restore the encoders from a checkpoint(mtx-ckpt-t-<time>.ckpt), the decoding
+   * resumes at the checkpoint time, the traffic before it should not be replayed.
+   * The encoders must be added in the order of the saving run.
+   */
+  void Restore(const std::string& filename);
+
+  /* Form and solve the flow equations of a block, append its flows.
+   * Each call has its own cplex env, the blocks can be decoded in parallel
+   * (see offline/mtx-offline-decoder.cc), each with cplexThreads threads,
+   * 0 lets cplex use all the cores.
+   */
+  static void DecodeBlock(const MtxBlock& block, FlowInfoVec_t<PckByteCnt>& flowPckByteInfo,
+			  int cplexThreads = 0);
  
 
 private:
@@ -38,23 +57,39 @@ private:
    */
   void DecodeFlowInfoAt(Ptr<MatrixEncoder> target, FlowInfoVec_t<PckByteCnt>& flowPckByteInfo);
 
-  /*Output the online decoded flow data(pck cnt and byte cnt)
+  /*Output the online decoded flow data(pck cnt and byte cnt) to the result file
    */
   void OutputDecodedFlows(int swID, const FlowInfoVec_t<PckByteCnt>& flows);
   
-  /*Output real flows for checking
+  /*Output real flows for checking to the result file
    */
   void OutputRealFlows(Ptr<MatrixEncoder> target);
   
-  /*Output the flow vector and countTable for offline decoding
+  /*Output the flow vector and countTable of each block to the result file for offline decoding
    */
   void OutputFlowSet(Ptr<MatrixEncoder> target);
 
+  /*Save the encoders of the period before it is decoded
+   */
+  void Checkpoint();
+
+  /*The result file is opened at the first output, a restored run does not overwrite
+   *the result of the saving run
+   */
+  Ptr<DecodeResultWriter> GetWriter();
+
 
 private:
   DecodedCallback_t                 m_decodedCallback; 
   //After we decoded a switch, we send the decoded flow(measuredFlows) to queue controller through this callback 
   std::vector<Ptr<MatrixEncoder> >  m_encoders;  
+  AccuracyChecker                   m_checker;   //decoded flows vs the encoders' real flows
+  Ptr<DecodeResultWriter>           m_writer;    //mtx-result.dcr, see DecodeResultReader::ConvertToText
+  Ptr<CheckpointSaver>              m_saver;
+  uint64_t                          m_numDecode; //periods decoded
+  double                            m_resumeTime;//the restored checkpoint time, 0 if not restored
+  bool                              m_restored;  //the next period is the restored one, it is not saved again
+  EventId                           m_firstDecode;
 };
   
 }
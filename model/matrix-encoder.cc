@@ -3,6 +3,8 @@
 #include "openflow-switch-net-device.h"
 #include "flow-hash.h"
 #include "flow-field.h"
+#include "radar-checkpoint.h"
+#include "stage-timer.h"
 
 #include "ns3/log.h"
 #include "ns3/assert.h"
@@ -12,6 +14,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <sstream>
 
 namespace ns3
 {
@@ -35,8 +38,12 @@ operator<<(std::ostream& os, const MtxFlow& mtxflow)
 }
 
 
-MatrixEncoder::MatrixEncoder() : m_packetReceived(0)
+MatrixEncoder::MatrixEncoder()
+  : m_realFlowCounter(RealFlows_t::allocator_type(m_memAccount.GetCounter(MEM_REAL_FLOWS))),
+    m_packetReceived(0)
 {
+  m_memAccount.Charge(MEM_FLOW_FILTER, sizeof(FlowFilter_t));
+
   //initialize the hash seeds
   m_blockSeed = std::rand() % 10;
   for(size_t i = 0; i < MTX_NUM_IDX; ++i)
@@ -50,7 +57,7 @@ MatrixEncoder::MatrixEncoder() : m_packetReceived(0)
     }
 
   //intialize the blocks
-  m_mtxBlocks.resize(MTX_NUM_BLOCK, MtxBlock());
+  m_mtxBlocks.resize(MTX_NUM_BLOCK, MtxBlock(m_memAccount));
   for(size_t i = 0; i < MTX_NUM_BLOCK; ++i)
     {
       m_mtxBlocks[i].m_countTable.resize(MTX_COUNT_TABLE_SIZE_IN_BLOCK);
@@ -65,6 +72,12 @@ MatrixEncoder::SetOFSwtch(Ptr<NetDevice> OFswtch, int id)
 {
   NS_LOG_FUNCTION(this);
   m_id = id;
+  m_memAccount.SetOwner(id);
+
+  std::stringstream ss;
+  ss << "sw-" << m_id << ".mtx-encoder.";
+  m_packetsMetric  = RadarMetrics::RegisterCounter(ss.str() + "packets");
+  m_newFlowsMetric = RadarMetrics::RegisterCounter(ss.str() + "new-flows");
   OFswtch->SetPromiscReceiveCallback(MakeCallback(&MatrixEncoder::ReceiveFromOpenFlowSwtch, this));
 }
 
@@ -75,6 +88,7 @@ MatrixEncoder::ReceiveFromOpenFlowSwtch(Ptr<NetDevice> ofswtch,
 					const Address& src, const Address& dst,
 					NetDevice::PacketType packetType)
 {
+  STAGE_TIMER(STAGE_ENCODER_RECEIVE);
   NS_LOG_FUNCTION("MtxEncoder ID " << m_id << " receive\n");
   Ptr<Packet> packet    = constPacket->Copy();
   FlowField   flow      = FlowFieldFromPacket (packet, protocol);
@@ -91,9 +105,9 @@ MatrixEncoder::ReceiveFromOpenFlowSwtch(Ptr<NetDevice> ofswtch,
   UpdateRealFlowCounter (flow, byte);
 
   ++m_packetReceived;
-  if(m_packetReceived % 1000 == 0)
-    std::cout << "MtxEncoder "    << m_id 
-	      << " received packets " << m_packetReceived << std::endl;
+  RadarMetrics::Add(m_packetsMetric);
+  if(isNew)
+    RadarMetrics::Add(m_newFlowsMetric);
   
   return true;
 }
@@ -104,7 +118,7 @@ MatrixEncoder::Clear()
   NS_LOG_INFO("MtxEncoder ID " << m_id << " reset");
 
   m_mtxBlocks.clear();
-  m_mtxBlocks.resize(MTX_NUM_BLOCK);
+  m_mtxBlocks.resize(MTX_NUM_BLOCK, MtxBlock(m_memAccount));
   for(size_t i = 0; i < MTX_NUM_BLOCK; ++i)
     {
       m_mtxBlocks[i].m_countTable.resize(MTX_COUNT_TABLE_SIZE_IN_BLOCK);
@@ -115,6 +129,79 @@ MatrixEncoder::Clear()
   m_packetReceived = 0;
 }
 
+void
+MatrixEncoder::Save(CheckpointOut& out) const
+{
+  out.Put(m_id);
+  out.Put(m_blockSeed);
+  out.PutVector(m_idxSeeds);
+  for(size_t bi = 0; bi < MTX_NUM_BLOCK; ++bi)
+    {
+      const MtxBlock& block = m_mtxBlocks[bi];
+      out.Put((uint64_t)block.m_flowTable.size());
+      for(size_t fi = 0; fi < block.m_flowTable.size(); ++fi)
+	{
+	  out.Put(block.m_flowTable[fi].m_flow);
+	  out.PutVector(block.m_flowTable[fi].m_countTableIDXs);
+	}
+      out.PutVector(block.m_countTable);
+    }
+  out.Put((uint64_t)m_realFlowCounter.size());
+  for(RealFlows_t::const_iterator it = m_realFlowCounter.begin();
+      it != m_realFlowCounter.end(); ++it)
+    {
+      out.Put(it->first);
+      out.Put(it->second);
+    }
+  out.Put(m_packetReceived);
+}
+
+void
+MatrixEncoder::Restore(CheckpointIn& in)
+{
+  int id;
+  in.Get(id);
+  if(id != m_id)
+    NS_FATAL_ERROR("checkpoint of MtxEncoder " << id << " restored at " << m_id);
+
+  Clear();
+  in.Get(m_blockSeed);
+  in.GetVector(m_idxSeeds);
+  for(size_t bi = 0; bi < MTX_NUM_BLOCK; ++bi)
+    {
+      MtxBlock& block = m_mtxBlocks[bi];
+      uint64_t  numFlow;
+      in.Get(numFlow);
+      block.m_flowTable.reserve(numFlow);
+      for(uint64_t fi = 0; fi < numFlow; ++fi)
+	{
+	  FlowField             flow;
+	  std::vector<uint16_t> idxs;
+	  in.Get(flow);
+	  in.GetVector(idxs);
+	  block.m_flowTable.push_back(MtxFlow(flow, idxs));
+
+	  //The flow vectors hold the flows new to the filter, they set its bits
+	  UpdateFlowFilter(flow);
+	}
+      in.GetVector(block.m_countTable);
+      NS_ASSERT(block.m_countTable.size() == MTX_COUNT_TABLE_SIZE_IN_BLOCK);
+    }
+
+  uint64_t numFlow;
+  in.Get(numFlow);
+  m_realFlowCounter.rehash(numFlow);
+  for(uint64_t i = 0; i < numFlow; ++i)
+    {
+      FlowField  flow;
+      PckByteCnt cnt;
+      in.Get(flow);
+      in.Get(cnt);
+      m_realFlowCounter[flow] = cnt;
+    }
+  in.Get(m_packetReceived);
+}
+
 void
 MatrixEncoder::UpdateMtxBlock(const FlowField& flow, bool isNew, uint32_t byte,
 			      uint16_t blockIdx,
@@ -148,7 +235,7 @@ MatrixEncoder::UpdateRealFlowCounter(const FlowField& flow, uint32_t byte)
    *the flow is new(because it might be wrong)
    */
   NS_LOG_FUNCTION(this);
-  FlowInfoHashMap_t<PckByteCnt>::iterator itFlow;
+  RealFlows_t::iterator itFlow;
   if( (itFlow = m_realFlowCounter.find(flow)) == m_realFlowCounter.end() )
     {
       m_realFlowCounter[flow] = PckByteCnt();
@@ -6,6 +6,8 @@
 
 #include "matrix-radar-config.h"
 #include "flow-field.h"
+#include "radar-metrics.h"
+#include "mem-accounting.h"
 
 #include <vector>
 #include <bitset>
@@ -16,6 +18,9 @@
 namespace ns3
 {
 
+class CheckpointOut;
+class CheckpointIn;
+
 //The FlowVec
 struct MtxFlow
 {
@@ -35,8 +40,21 @@ operator<<(std::ostream& os, const MtxFlow& mtxflow);
 //Each block contains 1 FlowVec(stores the flows mapped to this block) and 1 counterTable
 struct MtxBlock
 {
-  std::vector<MtxFlow>          m_flowTable;    //the flow vector
-  std::vector<PckByteFlowCnt>   m_countTable;   //the counter table, the info is aggregated 
+  typedef std::vector<MtxFlow, TrackingAllocator<MtxFlow> >                FlowTable_t;
+  typedef std::vector<PckByteFlowCnt, TrackingAllocator<PckByteFlowCnt> >  CountTable_t;
+
+  /* The tables are charged to MEM_UNTRACKED, e.g. the blocks read offline
+   */
+  MtxBlock () {}
+  /* The tables are charged to the account, e.g. the encoder's
+   */
+  explicit MtxBlock (MemAccount_t& account)
+    : m_flowTable(FlowTable_t::allocator_type(account.GetCounter(MEM_FLOW_TABLE))),
+      m_countTable(CountTable_t::allocator_type(account.GetCounter(MEM_COUNT_TABLE)))
+  {}
+
+  FlowTable_t                   m_flowTable;    //the flow vector
+  CountTable_t                  m_countTable;   //the counter table, the info is aggregated 
 };
 
     
@@ -65,9 +83,17 @@ public:
    */
   void Clear();
 
+  /* Save the seeds, mtx blocks and real flows to the checkpoint, restore
+   * them and rebuild the flow filter from the blocks' flows.
+   */
+  void Save (CheckpointOut& out) const;
+  void Restore (CheckpointIn& in);
+
   int                                   GetID()       { return m_id; }
   const std::vector<MtxBlock>&          GetMtxBlocks() { return m_mtxBlocks; }
-  const FlowInfoHashMap_t<PckByteCnt>&  GetRealFlowCounter() { return m_realFlowCounter; }
+  typedef FlowInfoHashMap_t<PckByteCnt, TrackingAllocator<std::pair<const FlowField, PckByteCnt> > > RealFlows_t;
+
+  const RealFlows_t&                    GetRealFlowCounter() { return m_realFlowCounter; }
   uint64_t                              GetTotalPacketsReceived() {return m_packetReceived;}
   
 private:
@@ -93,14 +119,17 @@ private:
   std::vector<uint16_t> GetCountTableIdx(const FlowField& flow);
   
   int                       m_id;         //id of the switch node
+  MemAccount_t              m_memAccount; //the switch's, declared before the charged containers
   unsigned                  m_blockSeed;  //seed to choose a group
   std::vector<unsigned>     m_idxSeeds;   //seed to choose idx in a group
 
   std::vector<MtxBlock>         m_mtxBlocks;  //mtx blocks, we have MTX_COUNT_SUBTABLEs
   typedef std::bitset<MTX_FLOW_FILTER_SIZE> FlowFilter_t;
   FlowFilter_t                  m_mtxFlowFilter;
-  FlowInfoHashMap_t<PckByteCnt> m_realFlowCounter; //the info is flow's packet byte cnt 
+  RealFlows_t                   m_realFlowCounter; //the info is flow's packet byte cnt 
   uint64_t                      m_packetReceived;
+  RadarMetrics::MetricId_t      m_packetsMetric;   //sw-<id>.mtx-encoder.packets
+  RadarMetrics::MetricId_t      m_newFlowsMetric;  //sw-<id>.mtx-encoder.new-flows
 };
   
 }
@@ -13,8 +13,11 @@ static const size_t MTX_NUM_FLOW_HASH    = 20;
 
 static const float MTX_PERIOD = 0.1f; //end 0.5s
 static const float MTX_END_TIME = 1.f;
+static const float MTX_TELEMETRY_PERIOD = 0.005f; //diff queue telemetry sample period
 
 static const bool  IS_OFFLINE_DECODE = false; //
+static const bool  MTX_OUTPUT_FLOWS = false; //save the measured and real flows to mtx-result.dcr, the AccuracyChecker checks in memory
+static const size_t MTX_CHECKPOINT_PERIODS = 0; //save the encoders every n periods to mtx-ckpt-t-<time>.ckpt, 0 disables
   
 }
 
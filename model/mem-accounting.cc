@@ -0,0 +1,185 @@
+#include "mem-accounting.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include "ns3/log.h"
+#include "ns3/system-mutex.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("MemAccounting");
+
+static const char* MEM_COMPONENT_NAMES[NUM_MEM_COMPONENTS] =
+{
+  "flowFilter",
+  "countTable",
+  "flowTable",
+  "realFlows",
+  "decodedFlows",
+  "graph",
+  "pathCache",
+  "packetData",
+  "untracked"
+};
+
+struct MemRegistry_t
+{
+  MemRegistry_t () : untracked(0) {}
+
+  SystemMutex                 mutex;
+  std::vector<MemAccount_t*>  accounts;
+  int64_t                     untracked;
+  std::ofstream               out;
+};
+
+/* Never destroyed, the accounts of the static objects may unregister after the
+ * static registry would be destroyed
+ */
+static MemRegistry_t&
+GetMemRegistry ()
+{
+  static MemRegistry_t* registry = new MemRegistry_t();
+  return *registry;
+}
+
+MemAccount_t::MemAccount_t ()
+  : m_owner(MEM_SHARED)
+{
+  std::fill(m_bytes, m_bytes + NUM_MEM_COMPONENTS, 0);
+  MemAccounting::Register(this);
+}
+
+MemAccount_t::~MemAccount_t ()
+{
+  MemAccounting::Unregister(this);
+}
+
+void
+MemAccounting::Register (MemAccount_t* account)
+{
+  MemRegistry_t&  r = GetMemRegistry();
+  CriticalSection cs(r.mutex);
+  r.accounts.push_back(account);
+}
+
+void
+MemAccounting::Unregister (MemAccount_t* account)
+{
+  MemRegistry_t&  r = GetMemRegistry();
+  CriticalSection cs(r.mutex);
+  r.accounts.erase(std::remove(r.accounts.begin(), r.accounts.end(), account), r.accounts.end());
+}
+
+int64_t*
+MemAccounting::GetUntrackedCounter ()
+{
+  return &GetMemRegistry().untracked;
+}
+
+int64_t
+MemAccounting::GetBytes (int owner, MemComponent_t component)
+{
+  MemRegistry_t&  r = GetMemRegistry();
+  CriticalSection cs(r.mutex);
+  int64_t         bytes = 0;
+  for(size_t i = 0; i < r.accounts.size(); ++i)
+    {
+      if(r.accounts[i]->GetOwner() == owner)
+	bytes += r.accounts[i]->GetBytes(component);
+    }
+  if(owner == MEM_SHARED && component == MEM_UNTRACKED)
+    bytes += __atomic_load_n(&r.untracked, __ATOMIC_RELAXED);
+  return bytes;
+}
+
+int64_t
+MemAccounting::GetTotalBytes (MemComponent_t component)
+{
+  MemRegistry_t&  r = GetMemRegistry();
+  CriticalSection cs(r.mutex);
+  int64_t         bytes = 0;
+  for(size_t i = 0; i < r.accounts.size(); ++i)
+    {
+      bytes += r.accounts[i]->GetBytes(component);
+    }
+  if(component == MEM_UNTRACKED)
+    bytes += __atomic_load_n(&r.untracked, __ATOMIC_RELAXED);
+  return bytes;
+}
+
+/* Write a line of the components' bytes and their sum
+ */
+static void
+OutputLine (std::ostream& os, double time, const char* owner, int id, const int64_t* bytes)
+{
+  int64_t sum = 0;
+  os << time << " " << owner;
+  if(id != MEM_SHARED)
+    os << id;
+  for(size_t c = 0; c < NUM_MEM_COMPONENTS; ++c)
+    {
+      os << " " << bytes[c];
+      sum += bytes[c];
+    }
+  os << " " << sum << "\n";
+}
+
+void
+MemAccounting::Report (double time)
+{
+  MemRegistry_t&  r = GetMemRegistry();
+  CriticalSection cs(r.mutex);
+
+  if(!r.out.is_open())
+    {
+      r.out.open("mem-accounting.txt");
+      if(!r.out)
+	NS_FATAL_ERROR("mem accounting file can not open");
+      r.out << "#time owner";
+      for(size_t c = 0; c < NUM_MEM_COMPONENTS; ++c)
+	r.out << " " << MEM_COMPONENT_NAMES[c];
+      r.out << " sum\n";
+    }
+
+  //owner -> bytes of the components, the switches in id order
+  typedef std::map<int, std::vector<int64_t> > OwnerBytes_t;
+  OwnerBytes_t         owners;
+  std::vector<int64_t> total(NUM_MEM_COMPONENTS, 0);
+  for(size_t i = 0; i < r.accounts.size(); ++i)
+    {
+      std::vector<int64_t>& bytes = owners[r.accounts[i]->GetOwner()];
+      bytes.resize(NUM_MEM_COMPONENTS, 0);
+      for(size_t c = 0; c < NUM_MEM_COMPONENTS; ++c)
+	{
+	  int64_t b = r.accounts[i]->GetBytes((MemComponent_t)c);
+	  bytes[c] += b;
+	  total[c] += b;
+	}
+    }
+  std::vector<int64_t>& shared    = owners[MEM_SHARED];
+  int64_t               untracked = __atomic_load_n(&r.untracked, __ATOMIC_RELAXED);
+  shared.resize(NUM_MEM_COMPONENTS, 0);
+  shared[MEM_UNTRACKED] += untracked;
+  total[MEM_UNTRACKED]  += untracked;
+
+  for(OwnerBytes_t::const_iterator it = owners.begin(); it != owners.end(); ++it)
+    {
+      if(it->first == MEM_SHARED)
+	OutputLine(r.out, time, "shared", MEM_SHARED, &it->second[0]);
+      else
+	OutputLine(r.out, time, "sw-", it->first, &it->second[0]);
+    }
+  OutputLine(r.out, time, "total", MEM_SHARED, &total[0]);
+  r.out.flush();
+
+  int64_t sum = 0;
+  for(size_t c = 0; c < NUM_MEM_COMPONENTS; ++c)
+    sum += total[c];
+  NS_LOG_INFO("Accounted memory at " << time << ": " << sum << " bytes");
+}
+
+}
@@ -0,0 +1,147 @@
+#ifndef MEM_ACCOUNTING_H
+#define MEM_ACCOUNTING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+
+namespace ns3
+{
+
+/* The accounted memory components
+ */
+enum MemComponent_t
+{
+  MEM_FLOW_FILTER = 0,   //the encoders' flow filters
+  MEM_COUNT_TABLE,       //the encoders' count tables
+  MEM_FLOW_TABLE,        //MatrixEncoder's block flow vectors
+  MEM_REAL_FLOWS,        //the encoders' real flow counters(the ground truth)
+  MEM_DECODED_FLOWS,     //FlowDecoder's decoded flows of a period
+  MEM_GRAPH,             //Graph's adjacency and dist table
+  MEM_PATH_CACHE,        //Graph's path index and edge arena
+  MEM_PACKET_DATA,       //OpenFlowSwitchNetDevice's buffered packets
+  MEM_UNTRACKED,         //containers of a default constructed TrackingAllocator
+  NUM_MEM_COMPONENTS
+};
+
+static const int MEM_SHARED = -1;  //the owner of the memory not of a switch
+
+/* The bytes of an owner's components, e.g. the encoder's of a switch.
+ * An account is registered while it lives, its owner is a switch ID or MEM_SHARED,
+ * the accounts of the same owner are summed in the report.
+ * Declare it before the containers charged to it, so it outlives them.
+ */
+class MemAccount_t
+{
+public:
+  MemAccount_t ();
+  ~MemAccount_t ();
+
+  void     SetOwner (int owner) { m_owner = owner; }
+  int      GetOwner () const { return m_owner; }
+
+  int64_t* GetCounter (MemComponent_t component) { return &m_bytes[component]; }
+  int64_t  GetBytes (MemComponent_t component) const
+  {
+    return __atomic_load_n(&m_bytes[component], __ATOMIC_RELAXED);
+  }
+
+  /* For the memory not allocated by a TrackingAllocator, e.g. a fixed size member
+   */
+  void     Charge (MemComponent_t component, int64_t bytes)
+  {
+    __atomic_add_fetch(&m_bytes[component], bytes, __ATOMIC_RELAXED);
+  }
+
+private:
+  MemAccount_t (const MemAccount_t&);
+  MemAccount_t& operator= (const MemAccount_t&);
+
+  int      m_owner;
+  int64_t  m_bytes[NUM_MEM_COMPONENTS];
+};
+
+/* The registered accounts
+ */
+class MemAccounting
+{
+public:
+  static void    Register (MemAccount_t* account);
+  static void    Unregister (MemAccount_t* account);
+
+  static int64_t GetBytes (int owner, MemComponent_t component);
+  static int64_t GetTotalBytes (MemComponent_t component);
+
+  /* The bytes of the default constructed TrackingAllocators
+   */
+  static int64_t* GetUntrackedCounter ();
+
+  /* Append the components' bytes of each owner and the total to mem-accounting.txt,
+   * the decoders report every period.
+   */
+  static void    Report (double time);
+};
+
+/* std::allocator that charges the bytes it allocates to a counter of a MemAccount_t.
+ * The counter is kept by the rebound allocators(e.g. the nodes of a hash map) and
+ * the copies of the container. A default constructed one charges MEM_UNTRACKED.
+ */
+template<class T>
+class TrackingAllocator : public std::allocator<T>
+{
+public:
+  typedef size_t    size_type;
+  typedef T*        pointer;
+#if __cplusplus >= 201103L
+  //std::allocator's is true, but the counters differ
+  typedef std::false_type is_always_equal;
+#endif
+
+  template<class U>
+  struct rebind
+  {
+    typedef TrackingAllocator<U> other;
+  };
+
+  TrackingAllocator () : m_bytes(MemAccounting::GetUntrackedCounter()) {}
+  explicit TrackingAllocator (int64_t* bytes) : m_bytes(bytes) {}
+  TrackingAllocator (const TrackingAllocator& o) : std::allocator<T>(o), m_bytes(o.m_bytes) {}
+  template<class U>
+  TrackingAllocator (const TrackingAllocator<U>& o) : m_bytes(o.GetCounter()) {}
+
+  pointer allocate (size_type n, const void* = 0)
+  {
+    pointer p = std::allocator<T>::allocate(n);
+    __atomic_add_fetch(m_bytes, (int64_t)(n * sizeof(T)), __ATOMIC_RELAXED);
+    return p;
+  }
+
+  void deallocate (pointer p, size_type n)
+  {
+    __atomic_sub_fetch(m_bytes, (int64_t)(n * sizeof(T)), __ATOMIC_RELAXED);
+    std::allocator<T>::deallocate(p, n);
+  }
+
+  int64_t* GetCounter () const { return m_bytes; }
+
+private:
+  int64_t* m_bytes;
+};
+
+template<class T, class U>
+inline bool
+operator== (const TrackingAllocator<T>& a, const TrackingAllocator<U>& b)
+{
+  return a.GetCounter() == b.GetCounter();
+}
+
+template<class T, class U>
+inline bool
+operator!= (const TrackingAllocator<T>& a, const TrackingAllocator<U>& b)
+{
+  return a.GetCounter() != b.GetCounter();
+}
+
+}
+
+#endif
@@ -18,6 +18,7 @@
 #ifdef NS3_OPENFLOW
 
 #include "openflow-switch-net-device.h"
+#include "stage-timer.h"
 
 #include "ns3/udp-l4-protocol.h"
 #include "ns3/tcp-l4-protocol.h"
@@ -94,7 +95,9 @@ OpenFlowSwitchNetDevice::GetTypeId (void)
 OpenFlowSwitchNetDevice::OpenFlowSwitchNetDevice ()
   : m_node (0),
     m_ifIndex (0),
-    m_mtu (0xffff)
+    m_mtu (0xffff),
+    m_packetData (std::less<uint32_t> (),
+                  PacketData_t::allocator_type (m_memAccount.GetCounter (MEM_PACKET_DATA)))
 {
   NS_LOG_FUNCTION_NOARGS ();
 
@@ -974,6 +977,7 @@ OpenFlowSwitchNetDevice::SendErrorMsg (uint16_t type, uint16_t code, const void
 void
 OpenFlowSwitchNetDevice::FlowTableLookup (sw_flow_key key, ofpbuf* buffer, uint32_t packet_uid, int port, bool send_to_controller)
 {
+  STAGE_TIMER(STAGE_FLOW_TABLE_LOOKUP);
   sw_flow *flow = chain_lookup (m_chain, &key);
   if (flow != 0)
     {
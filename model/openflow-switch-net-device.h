@@ -47,6 +47,7 @@
 #include <set>
 
 #include "openflow-interface.h"
+#include "mem-accounting.h"
 
 namespace ns3 {
 
@@ -223,6 +224,11 @@ public:
    */
   vport_table_t GetVPortTable ();
 
+  /**
+   * \param owner The switch ID the buffered packet data is charged to.
+   */
+  void SetMemAccountOwner (int owner) { m_memAccount.SetOwner (owner); }
+
 
   // From NetDevice
   virtual void SetIfIndex (const uint32_t index);
@@ -497,7 +503,10 @@ private:
   uint32_t m_ifIndex;                   ///< Interface Index
   uint16_t m_mtu;                       ///< Maximum Transmission Unit
 
-  typedef std::map<uint32_t,ofi::SwitchPacketMetadata> PacketData_t;
+  MemAccount_t m_memAccount;            ///< Memory accounting of the packet data
+
+  typedef std::map<uint32_t,ofi::SwitchPacketMetadata, std::less<uint32_t>,
+                   TrackingAllocator<std::pair<const uint32_t, ofi::SwitchPacketMetadata> > > PacketData_t;
   PacketData_t m_packetData;            ///< Packet data
 
   typedef std::vector<ofi::Port> Ports_t;
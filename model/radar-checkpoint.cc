@@ -0,0 +1,82 @@
+#include "radar-checkpoint.h"
+
+#include <cstdio>
+
+#include "ns3/log.h"
+#include "ns3/system-thread.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("RadarCheckpoint");
+
+CheckpointIn::CheckpointIn (const std::string& filename)
+  : m_pos(0)
+{
+  std::FILE* file = std::fopen(filename.c_str(), "rb");
+  if(!file)
+    NS_FATAL_ERROR("checkpoint file can not open");
+
+  char   buf[1 << 16];
+  size_t n;
+  while((n = std::fread(buf, 1, sizeof(buf), file)) > 0)
+    {
+      m_buffer.insert(m_buffer.end(), buf, buf + n);
+    }
+  std::fclose(file);
+  NS_LOG_INFO("Checkpoint " << filename << " of " << m_buffer.size() << " bytes");
+}
+
+void
+CheckpointIn::Check (uint64_t bytes) const
+{
+  if(m_pos + bytes > m_buffer.size())
+    NS_FATAL_ERROR("checkpoint file is truncated");
+}
+
+CheckpointSaver::CheckpointSaver ()
+{
+}
+
+CheckpointSaver::~CheckpointSaver ()
+{
+  Wait();
+}
+
+void
+CheckpointSaver::Save (const std::string& filename, CheckpointOut& snapshot)
+{
+  Wait();
+
+  m_filename = filename;
+  m_data.swap(snapshot.GetBuffer());
+  m_thread = Create<SystemThread>( MakeCallback(&CheckpointSaver::SaveThread, this) );
+  m_thread->Start();
+}
+
+void
+CheckpointSaver::Wait ()
+{
+  if(!m_thread)
+    return;
+  m_thread->Join();
+  m_thread = 0;
+}
+
+void
+CheckpointSaver::SaveThread ()
+{
+  std::string tmpname = m_filename + ".tmp";
+  std::FILE*  file    = std::fopen(tmpname.c_str(), "wb");
+  if(!file)
+    NS_FATAL_ERROR("checkpoint file can not open");
+  if(std::fwrite(&m_data[0], 1, m_data.size(), file) != m_data.size() ||
+     std::fclose(file) != 0)
+    NS_FATAL_ERROR("checkpoint file write failed");
+  if(std::rename(tmpname.c_str(), m_filename.c_str()) != 0)
+    NS_FATAL_ERROR("checkpoint file rename failed");
+
+  m_data.clear();
+}
+
+}
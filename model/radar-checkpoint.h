@@ -0,0 +1,142 @@
+#ifndef RADAR_CHECKPOINT_H
+#define RADAR_CHECKPOINT_H
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ns3/object.h"
+#include "ns3/assert.h"
+
+namespace ns3
+{
+
+class SystemThread;
+
+/* A checkpoint is the state of the encoders of a radar at a period boundary,
+ * taken before the period is decoded:
+ * CheckpointHeader_t, then each encoder's Save in the decoder's encoder order.
+ * The encoders' flow filters are not saved, they are rebuilt from the saved flows.
+ */
+static const char CHECKPOINT_MAGIC[8] = {'D', 'C', 'C', 'K', 'P', 'T', '1', '\0'};
+
+enum CheckpointRadar_t
+{
+  FLOW_RADAR_CHECKPOINT = 0,
+  MTX_RADAR_CHECKPOINT  = 1
+};
+
+struct CheckpointHeader_t
+{
+  char     magic[8];      //CHECKPOINT_MAGIC
+  uint32_t radar;         //CheckpointRadar_t
+  uint32_t numEncoders;
+  double   time;          //the period boundary in seconds
+  uint64_t numDecode;     //periods decoded before the time
+};
+
+/* Serializes the state into a buffer, the values are PODs
+ */
+class CheckpointOut
+{
+public:
+  CheckpointOut () {}
+
+  template<class T>
+  void Put (const T& v)
+  {
+    const char* p = (const char*)&v;
+    m_buffer.insert(m_buffer.end(), p, p + sizeof(T));
+  }
+
+  /* The size then the elements
+   */
+  template<class T, class A>
+  void PutVector (const std::vector<T, A>& v)
+  {
+    Put((uint64_t)v.size());
+    if(!v.empty())
+      {
+	const char* p = (const char*)&v[0];
+	m_buffer.insert(m_buffer.end(), p, p + v.size() * sizeof(T));
+      }
+  }
+
+  std::vector<char>& GetBuffer () { return m_buffer; }
+
+private:
+  std::vector<char> m_buffer;
+};
+
+/* Reads a checkpoint file, the values are read in the order they are put
+ */
+class CheckpointIn
+{
+public:
+  CheckpointIn (const std::string& filename);
+
+  template<class T>
+  void Get (T& v)
+  {
+    Check(sizeof(T));
+    std::memcpy(&v, &m_buffer[m_pos], sizeof(T));
+    m_pos += sizeof(T);
+  }
+
+  template<class T, class A>
+  void GetVector (std::vector<T, A>& v)
+  {
+    uint64_t n;
+    Get(n);
+    Check(n * sizeof(T));
+    v.resize(n);
+    if(n)
+      std::memcpy(&v[0], &m_buffer[m_pos], n * sizeof(T));
+    m_pos += n * sizeof(T);
+  }
+
+  bool AtEnd () const { return m_pos == m_buffer.size(); }
+
+private:
+  /* Fatal if the file is shorter than the values read
+   */
+  void Check (uint64_t bytes) const;
+
+  std::vector<char> m_buffer;
+  size_t            m_pos;
+};
+
+/* Writes the checkpoints on a background thread, the simulator only serializes
+ * the state. A checkpoint is written to <filename>.tmp and renamed when it is
+ * complete, so a crash while saving leaves the last complete checkpoint.
+ * One checkpoint is saved at a time, Save waits for the previous one.
+ */
+class CheckpointSaver : public Object
+{
+public:
+  CheckpointSaver ();
+  virtual ~CheckpointSaver ();
+
+  /* The snapshot's buffer is swapped out
+   */
+  void Save (const std::string& filename, CheckpointOut& snapshot);
+
+  /* Wait for the pending save
+   */
+  void Wait ();
+
+private:
+  CheckpointSaver(const CheckpointSaver&);
+  CheckpointSaver& operator=(const CheckpointSaver&);
+
+  void SaveThread ();
+
+  std::string        m_filename;
+  std::vector<char>  m_data;
+  Ptr<SystemThread>  m_thread;    //null if no save is pending
+};
+
+}
+
+#endif
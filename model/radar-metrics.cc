@@ -0,0 +1,218 @@
+#include "radar-metrics.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/system-mutex.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("RadarMetrics");
+
+__thread RadarMetrics::Shard_t* RadarMetrics::s_shard = 0;
+
+struct RadarMetrics::Registry_t
+{
+  Registry_t () : lastReportTime(0.) {}
+
+  SystemMutex               mutex;           //the names and the shards
+  std::vector<std::string>  counterNames;
+  std::vector<std::string>  histogramNames;
+  std::vector<Shard_t*>     shards;
+
+  std::ofstream             out;
+  Time                      period;
+  double                    lastReportTime;
+  std::vector<uint64_t>     lastCounters;    //the values of the last report
+  std::vector<uint64_t>     lastCounts;      //the histogram counts of the last report
+};
+
+RadarMetrics::Registry_t&
+RadarMetrics::GetRegistry ()
+{
+  static Registry_t registry;
+  return registry;
+}
+
+static RadarMetrics::MetricId_t
+FindOrAdd (std::vector<std::string>& names, const std::string& name, size_t maxNames)
+{
+  for(size_t i = 0; i < names.size(); ++i)
+    {
+      if(names[i] == name)
+	return i;
+    }
+  if(names.size() == maxNames)
+    NS_FATAL_ERROR("too many metrics, can not register " << name);
+  names.push_back(name);
+  return names.size() - 1;
+}
+
+RadarMetrics::MetricId_t
+RadarMetrics::RegisterCounter (const std::string& name)
+{
+  Registry_t&     r = GetRegistry();
+  CriticalSection cs(r.mutex);
+  return FindOrAdd(r.counterNames, name, MAX_COUNTERS);
+}
+
+RadarMetrics::MetricId_t
+RadarMetrics::RegisterHistogram (const std::string& name)
+{
+  Registry_t&     r = GetRegistry();
+  CriticalSection cs(r.mutex);
+  return FindOrAdd(r.histogramNames, name, MAX_HISTOGRAMS);
+}
+
+RadarMetrics::Shard_t*
+RadarMetrics::NewShard ()
+{
+  Shard_t*        shard = new Shard_t();
+  Registry_t&     r     = GetRegistry();
+  CriticalSection cs(r.mutex);
+  r.shards.push_back(shard);
+  return shard;
+}
+
+uint64_t
+RadarMetrics::GetCounter (MetricId_t counter)
+{
+  CriticalSection cs(GetRegistry().mutex);
+  return SumCounter(counter);
+}
+
+void
+RadarMetrics::GetHistogram (MetricId_t histogram, Histogram_t& h)
+{
+  CriticalSection cs(GetRegistry().mutex);
+  SumHistogram(histogram, h);
+}
+
+uint64_t
+RadarMetrics::SumCounter (MetricId_t counter)
+{
+  const std::vector<Shard_t*>& shards = GetRegistry().shards;
+  uint64_t                     sum    = 0;
+  for(size_t i = 0; i < shards.size(); ++i)
+    {
+      sum += __atomic_load_n(&shards[i]->counters[counter], __ATOMIC_RELAXED);
+    }
+  return sum;
+}
+
+void
+RadarMetrics::SumHistogram (MetricId_t histogram, Histogram_t& h)
+{
+  const std::vector<Shard_t*>& shards = GetRegistry().shards;
+  h.count = h.sum = h.max = 0;
+  for(size_t b = 0; b < NUM_BUCKETS; ++b)
+    {
+      h.buckets[b] = 0;
+    }
+  for(size_t i = 0; i < shards.size(); ++i)
+    {
+      Histogram_t& sh = shards[i]->histograms[histogram];
+      h.count += __atomic_load_n(&sh.count, __ATOMIC_RELAXED);
+      h.sum   += __atomic_load_n(&sh.sum, __ATOMIC_RELAXED);
+      h.max    = std::max(h.max, __atomic_load_n(&sh.max, __ATOMIC_RELAXED));
+      for(size_t b = 0; b < NUM_BUCKETS; ++b)
+	{
+	  h.buckets[b] += __atomic_load_n(&sh.buckets[b], __ATOMIC_RELAXED);
+	}
+    }
+}
+
+uint64_t
+RadarMetrics::Histogram_t::GetPercentile (double q) const
+{
+  uint64_t rank = (uint64_t)(q * count);
+  uint64_t cum  = 0;
+  for(size_t b = 0; b < NUM_BUCKETS; ++b)
+    {
+      cum += buckets[b];
+      if(cum > rank)
+	{
+	  uint64_t upper = (b == 0) ? 0 : (b == 64 ? max : ((uint64_t)1 << b) - 1);
+	  return std::min(upper, max);
+	}
+    }
+  return max;
+}
+
+void
+RadarMetrics::StartReporter (Time period, const std::string& filename)
+{
+  NS_LOG_FUNCTION(period << filename);
+  Registry_t& r = GetRegistry();
+  if(r.out.is_open())
+    return;
+
+  r.out.open(filename.c_str());
+  if(!r.out)
+    NS_FATAL_ERROR("metrics report file can not open");
+  r.out << "#time counter value rate\n"
+	<< "#time histogram count mean p50 p90 p99 max\n";
+  r.period = period;
+  Simulator::Schedule (period, &RadarMetrics::ReportPeriodically);
+  Simulator::ScheduleDestroy (&RadarMetrics::Close);
+}
+
+void
+RadarMetrics::ReportPeriodically ()
+{
+  Report();
+  //Stop with the simulation, the reporter alone does not keep it running
+  if(!Simulator::IsFinished())
+    Simulator::Schedule (GetRegistry().period, &RadarMetrics::ReportPeriodically);
+}
+
+void
+RadarMetrics::Close ()
+{
+  Report();
+  GetRegistry().out.close();
+}
+
+void
+RadarMetrics::Report ()
+{
+  Registry_t&     r = GetRegistry();
+  CriticalSection cs(r.mutex);
+  if(!r.out.is_open())
+    return;
+
+  double now      = Simulator::Now().GetSeconds();
+  double interval = now - r.lastReportTime;
+  r.lastCounters.resize(r.counterNames.size(), 0);
+  r.lastCounts.resize(r.histogramNames.size(), 0);
+
+  for(MetricId_t i = 0; i < r.counterNames.size(); ++i)
+    {
+      uint64_t v = SumCounter(i);
+      if(v == r.lastCounters[i])
+	continue;
+      r.out << now << " " << r.counterNames[i] << " " << v << " "
+	    << (interval > 0 ? (v - r.lastCounters[i]) / interval : 0.) << "\n";
+      r.lastCounters[i] = v;
+    }
+
+  for(MetricId_t i = 0; i < r.histogramNames.size(); ++i)
+    {
+      Histogram_t h;
+      SumHistogram(i, h);
+      if(h.count == r.lastCounts[i])
+	continue;
+      r.out << now << " " << r.histogramNames[i] << " " << h.count << " " << h.GetMean()
+	    << " " << h.GetPercentile(0.5) << " " << h.GetPercentile(0.9)
+	    << " " << h.GetPercentile(0.99) << " " << h.max << "\n";
+      r.lastCounts[i] = h.count;
+    }
+
+  r.lastReportTime = now;
+}
+
+}
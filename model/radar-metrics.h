@@ -0,0 +1,121 @@
+#ifndef RADAR_METRICS_H
+#define RADAR_METRICS_H
+
+#include <stdint.h>
+#include <string>
+
+#include "ns3/assert.h"
+#include "ns3/nstime.h"
+
+namespace ns3
+{
+
+static const float METRICS_REPORT_PERIOD = 0.01f; //simulated seconds between two reports
+
+/* Central registry of the counters and histograms of the simulation, e.g. the
+ * packets each encoder received, instead of printing them on the packet path.
+ *
+ * A metric is registered once by name and updated by its id. Every thread
+ * updates its own shard without lock, the shards are summed when the metrics
+ * are read, so the worker threads(FlowDecoder) can update them too.
+ * The reporter writes the metrics updated since its last report every period,
+ * it runs on the simulator thread.
+ */
+class RadarMetrics
+{
+public:
+  typedef uint32_t MetricId_t;
+
+  static const size_t MAX_COUNTERS   = 16384;
+  static const size_t MAX_HISTOGRAMS = 256;
+  /* Bucket 0 is the 0s, bucket b > 0 is [2^(b-1), 2^b)
+   */
+  static const size_t NUM_BUCKETS    = 65;
+
+  struct Histogram_t
+  {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[NUM_BUCKETS];
+
+    /* The upper bound of the bucket of the q quantile, at most max
+     */
+    uint64_t GetPercentile (double q) const;
+    double   GetMean () const { return count ? (double)sum / count : 0.; }
+  };
+
+  /* The id of the name, it is registered at the first time
+   */
+  static MetricId_t RegisterCounter   (const std::string& name);
+  static MetricId_t RegisterHistogram (const std::string& name);
+
+  static void Add (MetricId_t counter, uint64_t n = 1)
+  {
+    NS_ASSERT(counter < MAX_COUNTERS);
+    uint64_t& c = GetShard()->counters[counter];
+    __atomic_store_n(&c, c + n, __ATOMIC_RELAXED);
+  }
+
+  static void Record (MetricId_t histogram, uint64_t v)
+  {
+    NS_ASSERT(histogram < MAX_HISTOGRAMS);
+    Histogram_t& h = GetShard()->histograms[histogram];
+    size_t       b = v ? 64 - __builtin_clzll(v) : 0;
+    __atomic_store_n(&h.buckets[b], h.buckets[b] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h.sum, h.sum + v, __ATOMIC_RELAXED);
+    if(v > h.max)
+      __atomic_store_n(&h.max, v, __ATOMIC_RELAXED);
+    __atomic_store_n(&h.count, h.count + 1, __ATOMIC_RELAXED);
+  }
+
+  /* The sum of all threads
+   */
+  static uint64_t GetCounter   (MetricId_t counter);
+  static void     GetHistogram (MetricId_t histogram, Histogram_t& h);
+
+  /* Report every period to filename while there are simulator events, and
+   * at the simulator destroy.
+   */
+  static void StartReporter (Time period, const std::string& filename);
+
+private:
+  struct Registry_t;
+
+  struct Shard_t
+  {
+    uint64_t    counters[MAX_COUNTERS];
+    Histogram_t histograms[MAX_HISTOGRAMS];
+  };
+
+  static Shard_t* GetShard ()
+  {
+    if(!s_shard)
+      s_shard = NewShard();
+    return s_shard;
+  }
+
+  /* Allocate the calling thread's shard, the shards live until the exit so the
+   * updates of the exited threads are still reported.
+   */
+  static Shard_t* NewShard ();
+
+  static Registry_t& GetRegistry ();
+
+  /* The sums of the shards, the registry is locked
+   */
+  static uint64_t SumCounter (MetricId_t counter);
+  static void     SumHistogram (MetricId_t histogram, Histogram_t& h);
+
+  /* Write the metrics updated since the last report, the registry is locked
+   */
+  static void     Report ();
+  static void     ReportPeriodically ();
+  static void     Close ();
+
+  static __thread Shard_t* s_shard;
+};
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+
+#include "ns3/assert.h"
+
+namespace ns3{
+
+/* Bounded lock free queue of one producer thread and one consumer thread.
+ * The items are swapped in and out of the slots, a popped slot keeps the
+ * producer's next item(e.g. a std::vector buffer and its capacity is reused).
+ * m_head and m_tail count the items popped and pushed, each is written by one thread.
+ */
+template <class T>
+class SpscQueue
+{
+
+public:
+  SpscQueue(size_t capacity)
+    : m_slots(capacity), m_mask(capacity - 1), m_head(0), m_tail(0)
+  {
+    NS_ASSERT(capacity > 0 && (capacity & m_mask) == 0);
+  }
+
+  /* Producer, swap the item into the queue, false if it is full
+   */
+  bool TryPush (T& item)
+  {
+    size_t tail = m_tail;
+    if(tail - __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) == m_slots.size())
+      return false;
+
+    std::swap(m_slots[tail & m_mask], item);
+    __atomic_store_n(&m_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  /* Consumer, swap the front item out of the queue, false if it is empty
+   */
+  bool TryPop (T& item)
+  {
+    size_t head = m_head;
+    if(head == __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE))
+      return false;
+
+    std::swap(m_slots[head & m_mask], item);
+    __atomic_store_n(&m_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  bool IsEmpty () const
+  {
+    return __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) == __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+  }
+
+private:
+  SpscQueue(const SpscQueue&);
+  SpscQueue& operator=(const SpscQueue&);
+
+  std::vector<T>  m_slots;
+  size_t          m_mask;
+  size_t          m_head;
+  size_t          m_tail;
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "stage-timer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <time.h>
+
+#include "ns3/log.h"
+#include "ns3/system-mutex.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("StageTimers");
+
+__thread StageTimers::Shard_t* StageTimers::s_shard = 0;
+
+static const char* STAGE_NAMES[NUM_STAGES] =
+{
+  "encoder-receive",
+  "flow-table-lookup",
+  "diff-queue-enqueue",
+  "flow-single-decode",
+  "decode-flow-on-path",
+  "counter-decode",
+  "cplex-solve",
+  "output"
+};
+
+static uint64_t
+MonotonicNs ()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* The shards, and the ticks and ns at the first shard to convert the ticks to ns
+ */
+struct StageTimers::Registry_t
+{
+  Registry_t () : startTicks(StageTimers::Now()), startNs(MonotonicNs()) {}
+
+  SystemMutex            mutex;
+  std::vector<Shard_t*>  shards;
+  uint64_t               startTicks;
+  uint64_t               startNs;
+};
+
+StageTimers::Registry_t&
+StageTimers::GetRegistry ()
+{
+  static Registry_t registry;
+  return registry;
+}
+
+StageTimers::Shard_t*
+StageTimers::NewShard ()
+{
+  Shard_t*        shard = new Shard_t();
+  Registry_t&     r     = GetRegistry();
+  CriticalSection cs(r.mutex);
+  r.shards.push_back(shard);
+  return shard;
+}
+
+uint64_t
+StageTimers::GetBucketMax (size_t bucket)
+{
+  if(bucket < NUM_SUB_BUCKETS)
+    return bucket;
+  size_t   shift = bucket / NUM_SUB_BUCKETS - 1;
+  uint64_t sub   = bucket % NUM_SUB_BUCKETS;
+  return ((NUM_SUB_BUCKETS + sub) << shift) + (((uint64_t)1 << shift) - 1);
+}
+
+uint64_t
+StageTimers::GetPercentile (const Histogram_t& h, double q)
+{
+  uint64_t rank = (uint64_t)(q * h.count);
+  uint64_t cum  = 0;
+  for(size_t b = 0; b < NUM_BUCKETS; ++b)
+    {
+      cum += h.buckets[b];
+      if(cum > rank)
+	return std::min(GetBucketMax(b), h.max);
+    }
+  return h.max;
+}
+
+void
+StageTimers::Dump (const std::string& filename)
+{
+  Registry_t&     r = GetRegistry();
+  CriticalSection cs(r.mutex);
+
+  uint64_t ticks    = Now() - r.startTicks;
+  uint64_t ns       = MonotonicNs() - r.startNs;
+  double   nsPerTick = ticks ? (double)ns / ticks : 1.;
+
+  std::ofstream out(filename.c_str());
+  if(!out)
+    NS_FATAL_ERROR("stage timer file can not open");
+  out << "#ns per tick " << nsPerTick << ", " << r.shards.size() << " threads\n"
+      << "#stage count total_ms mean_ns p50_ns p90_ns p99_ns p999_ns max_ns\n";
+
+  for(size_t s = 0; s < NUM_STAGES; ++s)
+    {
+      Histogram_t h;
+      std::fill((uint64_t*)&h, (uint64_t*)(&h + 1), 0);
+      for(size_t i = 0; i < r.shards.size(); ++i)
+	{
+	  const Histogram_t& sh = r.shards[i]->stages[s];
+	  h.count += sh.count;
+	  h.sum   += sh.sum;
+	  h.max    = std::max(h.max, sh.max);
+	  for(size_t b = 0; b < NUM_BUCKETS; ++b)
+	    {
+	      h.buckets[b] += sh.buckets[b];
+	    }
+	}
+      if(h.count == 0)
+	continue;
+
+      out << STAGE_NAMES[s] << " " << h.count
+	  << " " << h.sum * nsPerTick / 1e6
+	  << " " << h.sum * nsPerTick / h.count
+	  << " " << GetPercentile(h, 0.5) * nsPerTick
+	  << " " << GetPercentile(h, 0.9) * nsPerTick
+	  << " " << GetPercentile(h, 0.99) * nsPerTick
+	  << " " << GetPercentile(h, 0.999) * nsPerTick
+	  << " " << h.max * nsPerTick << "\n";
+    }
+  NS_LOG_INFO("Stage timers saved to " << filename);
+}
+
+}
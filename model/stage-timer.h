@@ -0,0 +1,149 @@
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+namespace ns3
+{
+
+/* The timed stages of the packet path and the decoding
+ */
+enum Stage_t
+{
+  STAGE_ENCODER_RECEIVE = 0,   //FlowEncoder/MatrixEncoder::ReceiveFromOpenFlowSwtch
+  STAGE_FLOW_TABLE_LOOKUP,     //OpenFlowSwitchNetDevice::FlowTableLookup
+  STAGE_DIFF_QUEUE_ENQUEUE,    //DiffQueue::DoEnqueue
+  STAGE_FLOW_SINGLE_DECODE,    //FlowDecoder::FlowSingleDecode, the peeling
+  STAGE_DECODE_FLOW_ON_PATH,   //FlowDecoder::DecodeFlowOnPath
+  STAGE_COUNTER_DECODE,        //FlowDecoder::CounterSingleDecode, on the worker threads
+  STAGE_CPLEX_SOLVE,           //CplexSolveEquations
+  STAGE_OUTPUT,                //the decoders' Output* writers
+  NUM_STAGES
+};
+
+/* Time stamp counter timers of the stages, aggregated in a histogram per stage.
+ * The timers are compiled in only if RADAR_STAGE_TIMERS is defined
+ * (./waf configure --enable-stage-timers), else STAGE_TIMER is empty.
+ *
+ * The histograms are HDR style: values below NUM_SUB_BUCKETS are exact, above it
+ * every power of 2 range is split into NUM_SUB_BUCKETS linear buckets, so a
+ * recorded value is off by at most 1/NUM_SUB_BUCKETS. Each thread records to its
+ * own histograms, Dump merges them.
+ */
+class StageTimers
+{
+public:
+  static const size_t SUB_BUCKET_BITS = 4;
+  static const size_t NUM_SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const size_t NUM_BUCKETS     = (64 - SUB_BUCKET_BITS + 1) * NUM_SUB_BUCKETS;
+
+  static uint64_t Now ()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+  }
+
+  static void Record (Stage_t stage, uint64_t ticks)
+  {
+    Histogram_t& h = GetShard()->stages[stage];
+    ++h.buckets[GetBucket(ticks)];
+    ++h.count;
+    h.sum += ticks;
+    if(ticks > h.max)
+      h.max = ticks;
+  }
+
+  /* Write the stages' latency percentiles(ns) of all threads to filename.
+   * Call it when the timed threads are done, e.g. at the simulator destroy.
+   */
+  static void Dump (const std::string& filename);
+
+private:
+  struct Registry_t;
+
+  struct Histogram_t
+  {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[NUM_BUCKETS];
+  };
+
+  struct Shard_t
+  {
+    Histogram_t stages[NUM_STAGES];
+  };
+
+  static size_t GetBucket (uint64_t v)
+  {
+    if(v < NUM_SUB_BUCKETS)
+      return v;
+    size_t shift = 63 - __builtin_clzll(v) - SUB_BUCKET_BITS;
+    return (shift + 1) * NUM_SUB_BUCKETS + ((v >> shift) & (NUM_SUB_BUCKETS - 1));
+  }
+
+  /* The highest value of the bucket
+   */
+  static uint64_t GetBucketMax (size_t bucket);
+
+  /* The merged histogram's q quantile, at most max
+   */
+  static uint64_t GetPercentile (const Histogram_t& h, double q);
+
+  static Shard_t* GetShard ()
+  {
+    if(!s_shard)
+      s_shard = NewShard();
+    return s_shard;
+  }
+
+  /* Allocate the calling thread's shard, it lives until the exit
+   */
+  static Shard_t* NewShard ();
+
+  static Registry_t& GetRegistry ();
+
+  static __thread Shard_t* s_shard;
+};
+
+/* Record the time from the construction to the destruction
+ */
+class ScopedStageTimer
+{
+public:
+  ScopedStageTimer (Stage_t stage)
+    : m_stage(stage), m_start(StageTimers::Now())
+  {}
+
+  ~ScopedStageTimer ()
+  {
+    StageTimers::Record(m_stage, StageTimers::Now() - m_start);
+  }
+
+private:
+  Stage_t   m_stage;
+  uint64_t  m_start;
+};
+
+#ifdef RADAR_STAGE_TIMERS
+#define STAGE_TIMER(stage) ScopedStageTimer stageTimer (stage)
+#else
+#define STAGE_TIMER(stage)
+#endif
+
+}
+
+#endif
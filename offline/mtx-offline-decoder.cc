@@ -0,0 +1,192 @@
+/* Decodes the mtx blocks dumped by the MatrixDecoder(IS_OFFLINE_DECODE) outside
+ * the simulator, the blocks of all switches and periods are solved in parallel.
+ * The decoded flows and the dumped real flows are saved to a result file, so the
+ * decoding can be rerun with other solver settings without simulating again.
+ *
+ * Usage: mtx-offline-decoder --in=mtx-result.dcr --out=mtx-offline-result.dcr
+ *                            [--threads=8] [--text=1]
+ *
+ * With --convert, any result file(e.g. the simulator's fr-result.dcr) is only
+ * converted to the text files, --out is their name prefix(e.g. txt/):
+ *        mtx-offline-decoder --convert=fr-result.dcr [--out=txt/]
+ */
+
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "ns3/log.h"
+#include "ns3/command-line.h"
+#include "ns3/system-thread.h"
+#include "ns3/system-mutex.h"
+
+#include "ns3/matrix-encoder.h"
+#include "ns3/matrix-decoder.h"
+#include "ns3/decode-result.h"
+#include "ns3/work-queue.h"
+#include "ns3/stage-timer.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("MtxOfflineDecoder");
+
+class OfflineDecoder
+{
+public:
+  OfflineDecoder (const std::string& inFile)
+    : m_reader(inFile), m_numDone(0)
+  {}
+
+  /* Solve all the mtx blocks of the file with numThread threads
+   */
+  void Decode (unsigned numThread);
+
+  /* Save the decoded flows of each switch and period(the blocks merged), and
+   * the real flows of the dump
+   */
+  void Output (const std::string& outFile);
+
+private:
+  void WorkerThread ();
+
+  DecodeResultReader                       m_reader;
+  WorkQueue<size_t>                        m_workQueue;    //section idxs of the mtx blocks
+  std::vector<FlowInfoVec_t<PckByteCnt> >  m_blockFlows;   //decoded flows, idx is the section idx
+  SystemMutex                              m_doneMutex;
+  size_t                                   m_numDone;
+};
+
+void
+OfflineDecoder::Decode (unsigned numThread)
+{
+  size_t numBlock = 0;
+  m_blockFlows.resize(m_reader.GetNumSections());
+  for(size_t i = 0; i < m_reader.GetNumSections(); ++i)
+    {
+      if(m_reader.GetSection(i).type == MTX_BLOCK_SECTION)
+	{
+	  m_workQueue.PutWork(i);
+	  ++numBlock;
+	}
+    }
+  NS_LOG_INFO("Decoding " << numBlock << " blocks with " << numThread << " threads");
+
+  std::vector<Ptr<SystemThread> > threads;
+  for(unsigned ith = 0; ith < numThread; ++ith)
+    {
+      threads.push_back(Create<SystemThread>( MakeCallback(&OfflineDecoder::WorkerThread, this) ));
+      threads.back()->Start();
+    }
+  for(unsigned ith = 0; ith < numThread; ++ith)
+    {
+      threads[ith]->Join();
+    }
+}
+
+void
+OfflineDecoder::WorkerThread ()
+{
+  size_t   i;
+  MtxBlock block;
+  while( m_workQueue.TryGetWork(i) )
+    {
+      m_reader.ReadMtxBlock(i, block);
+      //Parallel over the blocks, each solve is single threaded
+      MatrixDecoder::DecodeBlock(block, m_blockFlows[i], 1);
+
+      CriticalSection cs(m_doneMutex);
+      ++m_numDone;
+      NS_LOG_LOGIC("Block " << m_reader.GetSection(i).block << " at sw " << m_reader.GetSection(i).swID
+		   << " t " << m_reader.GetSection(i).time << " decoded, " << m_numDone << " done");
+    }
+}
+
+void
+OfflineDecoder::Output (const std::string& outFile)
+{
+  Ptr<DecodeResultWriter> writer = Create<DecodeResultWriter>(outFile);
+
+  //The blocks of a switch in a period are dumped together, their flows are merged
+  FlowInfoVec_t<PckByteCnt> flows;
+  ResultSectionHeader_t     decoded;
+  bool                      isOpen = false;
+  for(size_t i = 0; i <= m_reader.GetNumSections(); ++i)
+    {
+      bool isEnd = (i == m_reader.GetNumSections());
+      if(isOpen && (isEnd ||
+		    m_reader.GetSection(i).type != MTX_BLOCK_SECTION ||
+		    m_reader.GetSection(i).swID != decoded.swID ||
+		    m_reader.GetSection(i).time != decoded.time))
+	{
+	  writer->WriteFlows(decoded, flows);
+	  flows.clear();
+	  isOpen = false;
+	}
+      if(isEnd)
+	break;
+
+      const ResultSectionHeader_t& hd = m_reader.GetSection(i);
+      if(hd.type == MTX_BLOCK_SECTION)
+	{
+	  if(!isOpen)
+	    {
+	      decoded       = hd;
+	      decoded.type  = DECODED_FLOWS_SECTION;
+	      decoded.block = 0;
+	      decoded.flags = RESULT_HAS_BYTES;
+	      isOpen        = true;
+	    }
+	  flows.insert(flows.end(), m_blockFlows[i].begin(), m_blockFlows[i].end());
+	}
+      else if(hd.type == REAL_FLOWS_SECTION)
+	{
+	  FlowInfoVec_t<PckByteCnt> realFlows;
+	  m_reader.ReadFlows(i, realFlows);
+	  writer->WriteFlows(hd, realFlows);
+	}
+    }
+
+  writer->Close();
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string inFile   = "mtx-result.dcr";
+  std::string outFile;
+  std::string convertFile;
+  unsigned    threads  = sysconf(_SC_NPROCESSORS_ONLN);
+  bool        text     = false;
+
+  CommandLine cmd;
+  cmd.AddValue("in",      "The result file of the simulation with the dumped mtx blocks", inFile);
+  cmd.AddValue("out",     "The result file of the offline decoded flows(mtx-offline-result.dcr), or the text prefix of --convert", outFile);
+  cmd.AddValue("threads", "Number of decoding threads", threads);
+  cmd.AddValue("text",    "Also convert the decoded result to text files", text);
+  cmd.AddValue("convert", "Only convert this result file to text files, prefixed with --out", convertFile);
+  cmd.Parse(argc, argv);
+
+  if(!convertFile.empty())
+    {
+      DecodeResultReader::ConvertToText(convertFile, outFile);
+      return 0;
+    }
+  if(outFile.empty())
+    outFile = "mtx-offline-result.dcr";
+
+  if(threads == 0)
+    threads = 1;
+
+  OfflineDecoder decoder(inFile);
+  decoder.Decode(threads);
+  decoder.Output(outFile);
+#ifdef RADAR_STAGE_TIMERS
+  StageTimers::Dump("mtx-offline-stage-timers.txt");
+#endif
+
+  if(text)
+    DecodeResultReader::ConvertToText(outFile);
+
+  return 0;
+}
@@ -0,0 +1,35 @@
+/* Converts a packet trace(the text trace or a pcap pcapng capture) into the binary
+ * columnar trace, which the TraceReader mmaps and decodes in place instead of
+ * parsing the text every run. Only the TCP and UDP packets are kept.
+ *
+ * Usage: trace-convert --in=trace.txt --out=trace.bin
+ */
+
+#include <string>
+
+#include "ns3/log.h"
+#include "ns3/command-line.h"
+
+#include "ns3/trace-reader.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("TraceConvert");
+
+int
+main (int argc, char *argv[])
+{
+  std::string inFile;
+  std::string outFile;
+
+  CommandLine cmd;
+  cmd.AddValue("in",  "The text trace or the pcap pcapng capture", inFile);
+  cmd.AddValue("out", "The binary trace", outFile);
+  cmd.Parse(argc, argv);
+
+  if(inFile.empty() || outFile.empty())
+    NS_FATAL_ERROR("Usage: trace-convert --in=<trace.txt> --out=<trace.bin>");
+
+  TraceReader::ConvertTextTrace(inFile.c_str(), outFile.c_str());
+  return 0;
+}
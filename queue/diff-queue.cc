@@ -4,8 +4,12 @@
 #include "ns3/log.h"
 #include "ns3/ipv4-l3-protocol.h"
 #include "ns3/ethernet-header.h"
+#include "ns3/boolean.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+#include "ns3/stage-timer.h"
 
-#include <cstdlib>
+#include <algorithm>
 #include <iostream>
 
 namespace ns3
@@ -14,11 +18,19 @@ namespace ns3
 NS_LOG_COMPONENT_DEFINE("DiffQueue");
 NS_OBJECT_ENSURE_REGISTERED(DiffQueue);
 
+const uint8_t DiffQueue::MICE_CLASS;
+
 TypeId DiffQueue::GetTypeId ()
 {
   static TypeId tid = TypeId("ns3::DiffQueue")
     .SetParent<Queue> ()
     .SetGroupName("Openflow")
+    .AddAttribute("NumClasses",
+		  "The number of classes, the mice and the elephant tiers",
+		  UintegerValue(2),
+		  MakeUintegerAccessor (&DiffQueue::SetNumClasses,
+					&DiffQueue::GetNumClasses),
+		  MakeUintegerChecker<uint32_t> (2, 256))
     .AddAttribute("MiceMaxPackets",
 		  "The max number of packets in mice queue",
 		  UintegerValue(100),
@@ -26,23 +38,40 @@ TypeId DiffQueue::GetTypeId ()
 					&DiffQueue::GetMiceMaxPackets),
 		  MakeUintegerChecker<uint32_t> ())
     .AddAttribute("ElephantMaxPackets",
-		  "The max number of packets in elephant queue",
+		  "The max number of packets in each elephant queue",
 		  UintegerValue(100),
 		  MakeUintegerAccessor (&DiffQueue::SetElephantMaxPackets,
 					&DiffQueue::GetElephantMaxPackets),
 		  MakeUintegerChecker<uint32_t> ())
-    .AddAttribute("MiceWeight",
-		  "The mice queue weight of scheduling",
-		  UintegerValue(5),
-		  MakeUintegerAccessor (&DiffQueue::SetMiceWeight,
-					&DiffQueue::GetMiceWeight),
-		  MakeUintegerChecker<uint16_t> ())
-    .AddAttribute("TotalWeight",
-		  "The total queue weight of mice and elephant",
-		  UintegerValue(10),
-		  MakeUintegerAccessor (&DiffQueue::SetTotalWeight,
-					&DiffQueue::GetTotalWeight),
-		  MakeUintegerChecker<uint16_t> ())
+    .AddAttribute("MiceMaxBytes",
+		  "The max number of bytes in mice queue",
+		  UintegerValue(100 * 1514),
+		  MakeUintegerAccessor (&DiffQueue::SetMiceMaxBytes,
+					&DiffQueue::GetMiceMaxBytes),
+		  MakeUintegerChecker<uint64_t> ())
+    .AddAttribute("ElephantMaxBytes",
+		  "The max number of bytes in each elephant queue",
+		  UintegerValue(100 * 1514),
+		  MakeUintegerAccessor (&DiffQueue::SetElephantMaxBytes,
+					&DiffQueue::GetElephantMaxBytes),
+		  MakeUintegerChecker<uint64_t> ())
+    .AddAttribute("Quantum",
+		  "The DRR quantum(bytes per round) of each class",
+		  UintegerValue(1514),
+		  MakeUintegerAccessor (&DiffQueue::SetQuantum,
+					&DiffQueue::GetQuantum),
+		  MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute("MaxElephantFlows",
+		  "The max number of elephant flows of the queue, the elephant table is allocated once",
+		  UintegerValue(256),
+		  MakeUintegerAccessor (&DiffQueue::SetMaxElephantFlows,
+					&DiffQueue::GetMaxElephantFlows),
+		  MakeUintegerChecker<uint32_t> ())
+    .AddAttribute("UseElephantFilter",
+		  "Classify the elephants with the fingerprint filter instead of the exact table",
+		  BooleanValue(false),
+		  MakeBooleanAccessor (&DiffQueue::m_useElephantFilter),
+		  MakeBooleanChecker ())
     .AddConstructor<DiffQueue> ()
   ;
 
@@ -50,20 +79,75 @@ TypeId DiffQueue::GetTypeId ()
 }
 
 DiffQueue::DiffQueue() 
-  :m_miceNPcks(0), m_miceNBytes(0),
-   m_elephantNPcks(0), m_elephantNBytes(0),
-   m_currentQueue(0)
+  :m_useElephantFilter(false),
+   m_classes(2), m_deficits(2, 0), m_peekDeficits(2, 0),
+   m_currentClass(0), m_quantumAdded(false),
+   m_swID(0), m_portID(0)
 {
    NS_LOG_FUNCTION(this);
+   SeedAqmRng();
 }
 
 DiffQueue::~DiffQueue()
 {
 }
 
+void
+DiffQueue::SetNumClasses(uint32_t numClasses)
+{
+  NS_ASSERT(numClasses >= 2 && numClasses <= 256);
+  for(size_t cls = numClasses; cls < m_classes.size(); ++cls)
+    {
+      NS_ASSERT_MSG(m_classes[cls].queue.empty(), "Remove a class with packets");
+    }
+
+  //The new elephant classes start with the config of the last one
+  Class_t newClass;
+  newClass.maxPackets = m_classes.back().maxPackets;
+  newClass.maxBytes   = m_classes.back().maxBytes;
+  newClass.quantum    = m_classes.back().quantum;
+  m_classes.resize(numClasses, newClass);
+  m_deficits.resize(numClasses, 0);
+  m_peekDeficits.resize(numClasses, 0);
+
+  if(m_currentClass >= numClasses)
+    {
+      m_currentClass = MICE_CLASS;
+      m_quantumAdded = false;
+    }
+}
+
+void
+DiffQueue::SetElephantMaxPackets(uint32_t maxPackets)
+{
+  for(size_t cls = MICE_CLASS + 1; cls < m_classes.size(); ++cls)
+    {
+      SetClassMaxPackets(cls, maxPackets);
+    }
+}
+
+void
+DiffQueue::SetElephantMaxBytes(uint64_t maxBytes)
+{
+  for(size_t cls = MICE_CLASS + 1; cls < m_classes.size(); ++cls)
+    {
+      SetClassMaxBytes(cls, maxBytes);
+    }
+}
+
+void
+DiffQueue::SetQuantum(uint32_t quantum)
+{
+  for(size_t cls = 0; cls < m_classes.size(); ++cls)
+    {
+      SetClassQuantum(cls, quantum);
+    }
+}
+
 bool 
 DiffQueue::DoEnqueue(Ptr<QueueItem> item)
 {
+  STAGE_TIMER(STAGE_DIFF_QUEUE_ENQUEUE);
   Ptr<Packet> packet = item->GetPacket()->Copy(); //dont change original packet
   /* Remove Ethernet header first, other wise the FlowFieldFromPacket will not work
    */
@@ -74,121 +158,204 @@ DiffQueue::DoEnqueue(Ptr<QueueItem> item)
   //the protocol parameter was filled by this callback. But here we manually set the protocol argument to IPv4
   FlowField   flow   = FlowFieldFromPacket(packet, Ipv4L3Protocol::PROT_NUMBER);
   NS_LOG_INFO("SW " << m_swID << " port " << m_portID  <<" receive a packet from flow: " << flow);
+  CheckAccounting();
 
-  /*
-  NS_LOG_INFO("E flow:");
-  for(ElephantFlowInfo_t::const_iterator ie = m_elephantFlowInfo.begin();
-      ie != m_elephantFlowInfo.end();
-      ++ie)
+  uint8_t  cls           = MICE_CLASS;
+  uint32_t dropThreshold = 0;
+  if(m_useElephantFilter)
     {
-      NS_LOG_INFO(ie->first << " " << ie->second);
+      uint8_t qDropRate;
+      if(m_elephantFilter.Find(flow, qDropRate, cls))
+	dropThreshold = qDropRate * 0x01010101u;  //q / 255 scaled to 2^32
     }
-  */
-
-  ElephantFlowInfo_t::const_iterator ie = m_elephantFlowInfo.find(flow);
-  if(ie == m_elephantFlowInfo.end())
+  else
     {
-      NS_LOG_INFO("Try enqueue mice");
-      if(m_miceNPcks >= m_miceMaxPackets)
+      const ElephantTable::ElephantInfo_t* info = m_elephantFlowInfo.Find(flow);
+      if(info)
 	{
-	  NS_LOG_INFO("The mice queue is full, drop");
-	  Drop(item->GetPacket());
-	  return false;
+	  cls           = info->cls;
+	  dropThreshold = info->dropThreshold;
 	}
-      m_miceQueue.push(item);
-      m_miceNPcks  += 1;
-      m_miceNBytes += item->GetPacketSize();
-      return true;
     }
-  else
+  if(cls >= m_classes.size())
     {
-      NS_LOG_INFO("Try enqueue elephant");
-      if(m_elephantNPcks >= m_elephantMaxPackets)
+      cls = m_classes.size() - 1;  //NumClasses shrinked after the elephants were set
+    }
+
+  Class_t& c    = m_classes[cls];
+  uint32_t size = item->GetPacketSize();
+  NS_LOG_INFO("Try enqueue class " << (unsigned)cls);
+  if(c.nPcks >= c.maxPackets || c.nBytes + size > c.maxBytes)
+    {
+      //The queue is full
+      NS_LOG_INFO("The class " << (unsigned)cls << " queue is full, drop");
+      c.stats.droppedPcks  += 1;
+      c.stats.droppedBytes += size;
+      Drop(item->GetPacket());
+      return false;
+    }
+  else if(cls != MICE_CLASS &&
+	  (c.nPcks >= c.maxPackets * 0.8 || c.nBytes >= c.maxBytes * 0.8))
+    {
+      //The queue is almost full, do active queue management. drop the packet randomly
+      //according to the drop rate of the flow
+      NS_LOG_INFO("The elephant queue is almost full, AQM");
+      if(m_aqmRng.Next() < dropThreshold)
 	{
-	  //The queue is full
-	  NS_LOG_INFO("The elephant queue is full, drop");
+	  NS_LOG_INFO("AQM drop");
+	  c.stats.aqmDroppedPcks += 1;
 	  Drop(item->GetPacket());
 	  return false;
 	}
-      else if(m_elephantNPcks >= m_elephantMaxPackets * 0.8)
+    }
+
+  Entry_t entry;
+  entry.item        = item;
+  entry.enqueueTime = Simulator::Now().GetTimeStep();
+  c.queue.push(entry);
+  c.nPcks  += 1;
+  c.nBytes += size;
+
+  c.stats.enqueuedPcks  += 1;
+  c.stats.enqueuedBytes += size;
+  c.stats.maxDepthPcks   = std::max(c.stats.maxDepthPcks, c.nPcks);
+  c.stats.maxDepthBytes  = std::max(c.stats.maxDepthBytes, c.nBytes);
+  return true;
+}
+
+Ptr<QueueItem>
+DiffQueue::DoDequeue()
+{
+  CheckAccounting();
+
+  uint8_t        cls     = Schedule(&m_deficits[0], m_currentClass, m_quantumAdded);
+  Class_t&       c       = m_classes[cls];
+  Ptr<QueueItem> item    = c.queue.front().item;
+  uint32_t       size    = item->GetPacketSize();
+  int64_t        sojourn = Simulator::Now().GetTimeStep() - c.queue.front().enqueueTime;
+
+  NS_LOG_INFO("Class " << (unsigned)cls << " dequeue");
+  c.queue.pop();
+  m_deficits[cls] -= size;
+  c.nPcks         -= 1;
+  c.nBytes        -= size;
+
+  c.stats.dequeuedPcks += 1;
+  c.stats.totalSojourn += sojourn;
+  c.stats.maxSojourn    = std::max(c.stats.maxSojourn, sojourn);
+  if(c.queue.empty())
+    {
+      m_deficits[cls] = 0;  //An idle class does not keep the credit
+    }
+  return item;
+}
+
+uint8_t
+DiffQueue::Schedule (uint32_t* deficits, uint8_t& currentClass, bool& quantumAdded) const
+{
+  /* Deficit round robin. A class gets its quantum when the round visits it, and
+   * sends while its head packet fits the deficit. There is a packet, so a class
+   * is found in a few rounds.
+   */
+  NS_ASSERT(GetNPackets() > 0);
+  for(;;)
+    {
+      const Class_t& c = m_classes[currentClass];
+      if(!c.queue.empty())
 	{
-	  //The queue is almost full, do active queue management. drop the packet randomly
-	  //according to the drop rate of the flow
-	  NS_LOG_INFO("The elephant queue is almost full, AQM");
-	  float bar      = (float) (std::rand()) / (float) RAND_MAX;
-	  float dropRate = ie->second; 
-	  if(bar < dropRate)
+	  if(!quantumAdded)
 	    {
-	      NS_LOG_INFO("AQM drop");
-	      Drop(item->GetPacket());
-	      return false;
+	      deficits[currentClass] += c.quantum;
+	      quantumAdded = true;
 	    }
+	  if(c.queue.front().item->GetPacketSize() <= deficits[currentClass])
+	    {
+	      return currentClass;
+	    }
+	}
+      else
+	{
+	  deficits[currentClass] = 0;
 	}
 
-      //TODO: Use the drop rate to decide whether to drop the elephant flow packets
-      m_elephantQueue.push(item);
-      m_elephantNPcks  += 1;
-      m_elephantNBytes += item->GetPacketSize();
-      return true;
+      currentClass = (currentClass + 1) % m_classes.size();
+      quantumAdded = false;
     }
-  
 }
 
-Ptr<QueueItem>
-DiffQueue::DoDequeue()
+Ptr<const QueueItem>
+DiffQueue::DoPeek () const
 {
+  std::copy(m_deficits.begin(), m_deficits.end(), m_peekDeficits.begin());
+  uint8_t currentClass = m_currentClass;
+  bool    quantumAdded = m_quantumAdded;
 
-  /*The steal must be sucess. Because if there is no packets in both queue.
-   * DoDequeue action will not happen.
-   */
-  Ptr<QueueItem> item = 0;
+  uint8_t cls = Schedule(&m_peekDeficits[0], currentClass, quantumAdded);
+  return m_classes[cls].queue.front().item;
+}
 
-  if( (m_currentQueue < m_miceWeight && !m_miceQueue.empty()) || 
-      (m_currentQueue >= m_miceWeight && m_elephantQueue.empty()))
+void
+DiffQueue::SampleClassStats(std::vector<ClassStats_t>& stats)
+{
+  stats.resize(m_classes.size());
+  for(size_t cls = 0; cls < m_classes.size(); ++cls)
     {
-      if(m_currentQueue < m_miceWeight) NS_LOG_INFO("Mice Turn, Mice dequeue");
-      else NS_LOG_INFO("Elep Turn, Mice steal");
+      Class_t& c = m_classes[cls];
+      stats[cls] = c.stats;
 
-      NS_ASSERT(!m_miceQueue.empty());
-
-      item = m_miceQueue.front();
-	  
-      m_miceNBytes -= item->GetPacketSize();
-      m_miceNPcks  -= 1;
-      m_miceQueue.pop();
+      c.stats = ClassStats_t();
+      c.stats.maxDepthPcks  = c.nPcks;
+      c.stats.maxDepthBytes = c.nBytes;
     }
-  else
+}
+
+void
+DiffQueue::SeedAqmRng ()
+{
+  uint64_t seed   = ((uint64_t)RngSeedManager::GetSeed() << 32) ^ RngSeedManager::GetRun();
+  uint64_t stream = ((uint64_t)(uint32_t)m_swID << 32) | (uint32_t)m_portID;
+  m_aqmRng.Seed(seed, stream);
+}
+
+void
+DiffQueue::CheckAccounting () const
+{
+#ifdef NS3_ASSERT_ENABLE
+  uint32_t nPcks  = 0;
+  uint64_t nBytes = 0;
+  for(size_t cls = 0; cls < m_classes.size(); ++cls)
     {
-      if(m_currentQueue >= m_miceWeight) NS_LOG_INFO("Elep Turn, Elep dequeue");
-      else NS_LOG_INFO("Mice Turn, Elep steal");
-      
-      NS_ASSERT(!m_elephantQueue.empty());
-      
-      item = m_elephantQueue.front();
-
-      m_elephantNBytes -= item->GetPacketSize();
-      m_elephantNPcks  -= 1;
-      m_elephantQueue.pop();
+      NS_ASSERT(m_classes[cls].queue.size() == m_classes[cls].nPcks);
+      nPcks  += m_classes[cls].nPcks;
+      nBytes += m_classes[cls].nBytes;
     }
-
-  m_currentQueue = ( ++m_currentQueue ) % m_totalWeight;
-  return item;
+  NS_ASSERT_MSG(nPcks == GetNPackets() && nBytes == GetNBytes(),
+		"DiffQueue class counts differ from the Queue's");
+#endif
 }
 
-Ptr<const QueueItem>
-DiffQueue::DoPeek () const
+void
+DiffQueue::EndElephantFlowUpdate()
 {
-  return 0;
+  m_elephantFlowInfo.EndUpdate();
+  if(!m_useElephantFilter)
+    return;
+
+  //The filter can't be walked or updated in place, rebuild it from the table
+  m_elephantFilter.Clear();
+  FlowField                     flow;
+  ElephantTable::ElephantInfo_t info;
+  for(size_t slot = 0; slot < m_elephantFlowInfo.GetNumSlots(); ++slot)
+    {
+      if(m_elephantFlowInfo.GetSlot(slot, flow, info))
+	m_elephantFilter.Insert(flow, info.dropRate, info.cls);
+    }
 }
 
 void DiffQueue::PrintElephantFlowInfo() const
 {
   std::cout << "elep flow drop rate" << std::endl;
-  ElephantFlowInfo_t::const_iterator it = m_elephantFlowInfo.begin();
-  for(;it != m_elephantFlowInfo.end(); ++it)
-    {
-      std::cout << it->first << " drop rate " << it->second << std::endl;
-    }
+  m_elephantFlowInfo.Print(std::cout);
 }
 
 }
@@ -3,67 +3,167 @@
 #define DIFF_QUEUE_H
 
 #include <queue>
+#include <vector>
 
 #include "ns3/queue.h"
+#include "ns3/assert.h"
 #include "ns3/flow-field.h"
+#include "ns3/elephant-table.h"
+#include "ns3/elephant-filter.h"
+#include "ns3/pcg-random.h"
 
 namespace ns3 {
 
+/* DiffQueue separates the mice and elephant flows of a switch port.
+ * Class 0 is the mice, classes 1..N-1 are the elephant tiers, the elephant
+ * table gives an elephant's tier. The classes are scheduled by deficit round
+ * robin with byte quantums, each class has a packet and a byte limited buffer.
+ */
 class DiffQueue : public Queue {
 
 public:
   static TypeId GetTypeId (void);
   
+  static const uint8_t MICE_CLASS = 0;
+
+  /* Per class telemetry counters of a sample interval
+   * Sojourn times are in ns-3 time steps.
+   */
+  struct ClassStats_t
+  {
+    ClassStats_t() : enqueuedPcks(0), enqueuedBytes(0), droppedPcks(0), droppedBytes(0),
+		     aqmDroppedPcks(0), dequeuedPcks(0), maxDepthPcks(0), maxDepthBytes(0),
+		     totalSojourn(0), maxSojourn(0)
+    {}
+
+    uint64_t enqueuedPcks;
+    uint64_t enqueuedBytes;
+    uint64_t droppedPcks;     //the class buffer is full
+    uint64_t droppedBytes;
+    uint64_t aqmDroppedPcks;
+    uint64_t dequeuedPcks;
+    uint32_t maxDepthPcks;
+    uint64_t maxDepthBytes;
+    int64_t  totalSojourn;    //of the dequeued packets
+    int64_t  maxSojourn;
+  };
+
   DiffQueue ();
   virtual ~DiffQueue();
- 
-  void      SetMiceMaxPackets(uint32_t maxPackets) {m_miceMaxPackets = maxPackets;}
-  uint32_t  GetMiceMaxPackets() const { return m_miceMaxPackets;}
-  void      SetElephantMaxPackets(uint32_t maxPackets) {m_elephantMaxPackets = maxPackets;}
-  uint32_t  GetElephantMaxPackets() const {return m_elephantMaxPackets;}
 
-  void      SetMiceWeight(uint16_t miceW) { m_miceWeight = miceW;}
-  uint16_t  GetMiceWeight() const {return m_miceWeight;}
-  void      SetTotalWeight(uint16_t totalW) { m_totalWeight = totalW;}
-  uint16_t  GetTotalWeight() const {return m_totalWeight;}
-
-  void      SetPortID(int portID) {m_portID = portID;};
+  void      SetNumClasses(uint32_t numClasses);
+  uint32_t  GetNumClasses() const { return m_classes.size();}
+
+  void      SetClassMaxPackets(uint8_t cls, uint32_t maxPackets) { m_classes[cls].maxPackets = maxPackets;}
+  uint32_t  GetClassMaxPackets(uint8_t cls) const { return m_classes[cls].maxPackets;}
+  void      SetClassMaxBytes(uint8_t cls, uint64_t maxBytes) { m_classes[cls].maxBytes = maxBytes;}
+  uint64_t  GetClassMaxBytes(uint8_t cls) const { return m_classes[cls].maxBytes;}
+  /* Bytes the class can send per DRR round
+   */
+  void      SetClassQuantum(uint8_t cls, uint32_t quantum) { NS_ASSERT(quantum > 0); m_classes[cls].quantum = quantum;}
+  uint32_t  GetClassQuantum(uint8_t cls) const { return m_classes[cls].quantum;}
+  uint32_t  GetClassNPackets(uint8_t cls) const { return m_classes[cls].nPcks;}
+  uint64_t  GetClassNBytes(uint8_t cls) const { return m_classes[cls].nBytes;}
+ 
+  /* Mice is class 0, the elephant setters apply to all elephant classes
+   */
+  void      SetMiceMaxPackets(uint32_t maxPackets) { SetClassMaxPackets(MICE_CLASS, maxPackets);}
+  uint32_t  GetMiceMaxPackets() const { return GetClassMaxPackets(MICE_CLASS);}
+  void      SetElephantMaxPackets(uint32_t maxPackets);
+  uint32_t  GetElephantMaxPackets() const {return GetClassMaxPackets(MICE_CLASS + 1);}
+  void      SetMiceMaxBytes(uint64_t maxBytes) { SetClassMaxBytes(MICE_CLASS, maxBytes);}
+  uint64_t  GetMiceMaxBytes() const { return GetClassMaxBytes(MICE_CLASS);}
+  void      SetElephantMaxBytes(uint64_t maxBytes);
+  uint64_t  GetElephantMaxBytes() const {return GetClassMaxBytes(MICE_CLASS + 1);}
+  void      SetQuantum(uint32_t quantum);
+  uint32_t  GetQuantum() const {return GetClassQuantum(MICE_CLASS);}
+
+  /* The AQM random stream is reseeded by the switch and port ID
+   */
+  void      SetPortID(int portID) {m_portID = portID; SeedAqmRng();};
   int       GetPortID() const {return m_portID;};
-  void      SetSWID(int swID) {m_swID = swID;};
+  void      SetSWID(int swID) {m_swID = swID; SeedAqmRng();};
   int       GetSWID() const {return m_swID;};
  
-  void      ClearElephantFlowInfo() { m_elephantFlowInfo.clear();}
-  void      SetElephantFlowInfo(const FlowField& ef, float droprate) { m_elephantFlowInfo[ef] = droprate;}
+  void      SetMaxElephantFlows(uint32_t maxFlows) { m_elephantFlowInfo.Reserve(maxFlows); m_elephantFilter.Reserve(maxFlows);}
+  uint32_t  GetMaxElephantFlows() const { return m_elephantFlowInfo.GetMaxFlows();}
+
+  /* Update the elephant flows by diff:
+   * BeginElephantFlowUpdate(); SetElephantFlowInfo(...) for each elephant; EndElephantFlowUpdate();
+   * The elephants not set in between are removed. cls is the elephant's class(tier), >= 1.
+   */
+  void      BeginElephantFlowUpdate() { m_elephantFlowInfo.BeginUpdate();}
+  bool      SetElephantFlowInfo(const FlowField& ef, float droprate, uint8_t cls = MICE_CLASS + 1)
+  {
+    NS_ASSERT(cls != MICE_CLASS && cls < m_classes.size());
+    return m_elephantFlowInfo.Set(ef, droprate, cls);
+  }
+  void      EndElephantFlowUpdate();
+  void      ClearElephantFlowInfo() { m_elephantFlowInfo.Clear(); m_elephantFilter.Clear();}
   void      PrintElephantFlowInfo() const;
 
+  /* Copy the classes' counters since the last sample into stats and start a new
+   * interval, the max depths start from the current depths.
+   */
+  void      SampleClassStats(std::vector<ClassStats_t>& stats);
+
 private:
 
   virtual bool DoEnqueue (Ptr<QueueItem> item);
   virtual Ptr<QueueItem> DoDequeue ();
+  /* The packet DoDequeue would return, the DRR state is not changed
+   */
   virtual Ptr<const QueueItem> DoPeek() const;
 
-  typedef FlowInfoHashMap_t<float> ElephantFlowInfo_t; //currently we only store the drop rate.
-  //Elephant flow info, use it to check if a flow is a elephant flow, if it is,
-  //Drop the packet according to the drop rate.
-  ElephantFlowInfo_t           m_elephantFlowInfo;
+  /* Run the DRR from currentClass until a class can send its head packet, return the class.
+   * DoDequeue runs it on m_deficits, DoPeek on a copy. There must be a packet in the queue.
+   */
+  uint8_t Schedule (uint32_t* deficits, uint8_t& currentClass, bool& quantumAdded) const;
 
-  std::queue<Ptr<QueueItem> >  m_miceQueue;
-  std::queue<Ptr<QueueItem> >  m_elephantQueue;
+  /* The classes' packet and byte counts add up to the base Queue's
+   */
+  void CheckAccounting () const;
 
-  uint32_t             m_miceMaxPackets;
-  uint64_t             m_miceMaxBytes;
-  uint32_t             m_miceNPcks;     //current packets in the queue
-  uint64_t             m_miceNBytes;    //current bytes in the queue
-  
+  /* Seed m_aqmRng from the ns-3 seed and run number, the stream is the queue's
+   * (switch, port), so the drops are reproducible for a run.
+   */
+  void SeedAqmRng ();
 
-  uint32_t             m_elephantMaxPackets;
-  uint64_t             m_elephantMaxBytes;
-  uint32_t             m_elephantNPcks;  //current elephant packets in the queue
-  uint64_t             m_elephantNBytes; //current elephant bytes in the queue
-   
-  uint16_t             m_miceWeight;
-  uint16_t             m_totalWeight;
-  uint16_t             m_currentQueue;
+  //Elephant flow info, use it to check if a flow is a elephant flow, if it is,
+  //put it in its class and drop the packet according to the drop rate.
+  ElephantTable                m_elephantFlowInfo;
+  //Fingerprint copy of m_elephantFlowInfo, rebuilt every update. If m_useElephantFilter,
+  //the enqueue path classifies with it instead, at a bounded false positive rate.
+  ElephantFilter               m_elephantFilter;
+  bool                         m_useElephantFilter;
+
+  struct Entry_t
+  {
+    Ptr<QueueItem> item;
+    int64_t        enqueueTime;  //time step, for the sojourn time
+  };
+
+  struct Class_t
+  {
+    Class_t() : maxPackets(0), maxBytes(0), nPcks(0), nBytes(0), quantum(1)
+    {}
+
+    std::queue<Entry_t>          queue;
+    uint32_t                     maxPackets;
+    uint64_t                     maxBytes;
+    uint32_t                     nPcks;     //current packets in the queue
+    uint64_t                     nBytes;    //current bytes in the queue
+    uint32_t                     quantum;   //bytes added to the deficit each round
+    ClassStats_t                 stats;
+  };
+
+  std::vector<Class_t>           m_classes;
+  std::vector<uint32_t>          m_deficits;     //bytes each class can still send in this round
+  mutable std::vector<uint32_t>  m_peekDeficits; //DoPeek scratch
+  uint8_t                        m_currentClass;  //the class of the DRR round
+  bool                           m_quantumAdded;  //the current class got its quantum in this round
+
+  Pcg32                m_aqmRng;   //the AQM's own random stream
 
   int                  m_swID;
   int                  m_portID;
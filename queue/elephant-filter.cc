@@ -0,0 +1,102 @@
+
+#include "elephant-filter.h"
+
+#include "ns3/log.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("ElephantFilter");
+
+const unsigned ElephantFilter::BUCKET_SIZE;
+const uint32_t ElephantFilter::FILTER_HASH_SEED;
+const uint16_t ElephantFilter::EMPTY_FP;
+const unsigned ElephantFilter::MAX_KICKS;
+
+ElephantFilter::ElephantFilter ()
+  : m_mask(0), m_kickSeed(0x2BAD)
+{
+}
+
+void
+ElephantFilter::Reserve (uint32_t maxFlows)
+{
+  size_t numBucket = 1;
+  while(numBucket * BUCKET_SIZE < 2 * (size_t)maxFlows)
+    {
+      numBucket <<= 1;
+    }
+
+  m_fps.assign(numBucket * BUCKET_SIZE, EMPTY_FP);
+  m_qDropRates.assign(numBucket * BUCKET_SIZE, 0);
+  m_classes.assign(numBucket * BUCKET_SIZE, 0);
+  m_mask = numBucket - 1;
+}
+
+void
+ElephantFilter::Clear ()
+{
+  std::fill(m_fps.begin(), m_fps.end(), EMPTY_FP);
+}
+
+uint8_t
+ElephantFilter::QuantiseDropRate (float dropRate)
+{
+  if(dropRate <= 0) return 0;
+  if(dropRate >= 1) return 255;
+  return (uint8_t)(dropRate * 255 + 0.5f);
+}
+
+bool
+ElephantFilter::InsertInBucket (size_t bucket, uint16_t fp, uint8_t qDropRate, uint8_t cls)
+{
+  uint16_t* fps = &m_fps[bucket * BUCKET_SIZE];
+  for(unsigned i = 0; i < BUCKET_SIZE; ++i)
+    {
+      if(fps[i] == EMPTY_FP)
+	{
+	  fps[i] = fp;
+	  m_qDropRates[bucket * BUCKET_SIZE + i] = qDropRate;
+	  m_classes[bucket * BUCKET_SIZE + i]    = cls;
+	  return true;
+	}
+    }
+  return false;
+}
+
+bool
+ElephantFilter::Insert (const FlowField& flow, float dropRate, uint8_t cls)
+{
+  NS_ASSERT_MSG(!m_fps.empty(), "ElephantFilter is not reserved");
+
+  uint32_t h     = FlowFieldHash(flow, FILTER_HASH_SEED);
+  uint16_t fp    = Fingerprint(h);
+  uint8_t  qRate = QuantiseDropRate(dropRate);
+  size_t   b1    = h & m_mask;
+  size_t   b2    = AltBucket(b1, fp);
+
+  if(InsertInBucket(b1, fp, qRate, cls) || InsertInBucket(b2, fp, qRate, cls))
+    return true;
+
+  //Both buckets are full, kick a fingerprint to its other bucket
+  size_t bucket = b2;
+  for(unsigned kick = 0; kick < MAX_KICKS; ++kick)
+    {
+      m_kickSeed = m_kickSeed * 1664525 + 1013904223;
+      size_t slot = bucket * BUCKET_SIZE + (m_kickSeed >> 16) % BUCKET_SIZE;
+      std::swap(fp, m_fps[slot]);
+      std::swap(qRate, m_qDropRates[slot]);
+      std::swap(cls, m_classes[slot]);
+
+      bucket = AltBucket(bucket, fp);
+      if(InsertInBucket(bucket, fp, qRate, cls))
+	return true;
+    }
+
+  NS_LOG_WARN("Elephant filter is full, a fingerprint is lost");
+  return false;
+}
+
+}
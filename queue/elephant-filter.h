@@ -0,0 +1,96 @@
+
+#ifndef ELEPHANT_FILTER_H
+#define ELEPHANT_FILTER_H
+
+#include <vector>
+
+#include "ns3/flow-field.h"
+
+namespace ns3 {
+
+/* Compact elephant classifier of the DiffQueue enqueue path, a cuckoo filter.
+ * Each elephant takes a 16 bit flow fingerprint, an 8 bit quantised drop rate
+ * and its 8 bit class, 4 bytes, the filter of 256 elephants is 2KB and stays in L1.
+ *
+ * A flow is checked in its 2 buckets of BUCKET_SIZE slots, the fingerprints
+ * of a bucket are contiguous. A mice flow is misclassified as an elephant if
+ * it matches one of the 2 * BUCKET_SIZE fingerprints, the false positive rate
+ * is at most 2 * BUCKET_SIZE / 2^16 (1.2e-4). There is no false negative unless
+ * an insert fails.
+ */
+class ElephantFilter
+{
+public:
+  static const unsigned BUCKET_SIZE = 4;
+
+  ElephantFilter ();
+
+  /* Allocate the buckets for maxFlows elephants(load factor <= 1/2),
+   * the filter is cleared.
+   */
+  void      Reserve (uint32_t maxFlows);
+  void      Clear ();
+
+  /* Insert the elephant, return false if the filter is too full(a victim
+   * fingerprint may be lost).
+   */
+  bool      Insert (const FlowField& flow, float dropRate, uint8_t cls);
+
+  /* Is the flow an elephant, its drop rate quantised to [0, 255] is in qDropRate,
+   * its class in cls.
+   */
+  bool      Find (const FlowField& flow, uint8_t& qDropRate, uint8_t& cls) const
+  {
+    uint32_t h  = FlowFieldHash(flow, FILTER_HASH_SEED);
+    uint16_t fp = Fingerprint(h);
+    size_t   b1 = h & m_mask;
+    size_t   b2 = AltBucket(b1, fp);
+    return FindInBucket(b1, fp, qDropRate, cls) || FindInBucket(b2, fp, qDropRate, cls);
+  }
+
+  static uint8_t QuantiseDropRate (float dropRate);
+
+private:
+  static const uint32_t FILTER_HASH_SEED = 0xe1e9;
+  static const uint16_t EMPTY_FP         = 0;
+  static const unsigned MAX_KICKS        = 256;
+
+  static uint16_t Fingerprint (uint32_t h)
+  {
+    uint16_t fp = h >> 16;
+    return (fp == EMPTY_FP) ? 1 : fp;
+  }
+
+  size_t AltBucket (size_t bucket, uint16_t fp) const
+  {
+    //b1 ^ hash(fp) == b2 and b2 ^ hash(fp) == b1, a moved fingerprint finds its other bucket
+    return (bucket ^ (size_t)((uint32_t)fp * 0x5bd1e995u)) & m_mask;
+  }
+
+  bool FindInBucket (size_t bucket, uint16_t fp, uint8_t& qDropRate, uint8_t& cls) const
+  {
+    const uint16_t* fps = &m_fps[bucket * BUCKET_SIZE];
+    for(unsigned i = 0; i < BUCKET_SIZE; ++i)
+      {
+	if(fps[i] == fp)
+	  {
+	    qDropRate = m_qDropRates[bucket * BUCKET_SIZE + i];
+	    cls       = m_classes[bucket * BUCKET_SIZE + i];
+	    return true;
+	  }
+      }
+    return false;
+  }
+
+  bool InsertInBucket (size_t bucket, uint16_t fp, uint8_t qDropRate, uint8_t cls);
+
+  std::vector<uint16_t> m_fps;         //BUCKET_SIZE fingerprints per bucket
+  std::vector<uint8_t>  m_qDropRates;  //quantised drop rate of each fingerprint
+  std::vector<uint8_t>  m_classes;     //class of each fingerprint
+  size_t                m_mask;        //num of buckets - 1
+  uint32_t              m_kickSeed;    //choose the slot to kick out
+};
+
+}
+
+#endif
@@ -0,0 +1,160 @@
+
+#include "elephant-table.h"
+
+#include "ns3/log.h"
+
+#include <iostream>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("ElephantTable");
+
+static const uint32_t ELEPHANT_HASH_SEED = 0x5eed;
+
+const uint32_t ElephantTable::EMPTY_EPOCH;
+
+ElephantTable::ElephantTable ()
+  : m_mask(0), m_maxFlows(0), m_size(0), m_epoch(EMPTY_EPOCH + 1)
+{
+}
+
+void
+ElephantTable::Reserve (uint32_t maxFlows)
+{
+  //Keep the load factor <= 1/2, the probe sequences stay short
+  size_t capacity = 16;
+  while(capacity < 2 * (size_t)maxFlows)
+    {
+      capacity <<= 1;
+    }
+
+  Slot_t empty;
+  empty.info.dropRate      = 0;
+  empty.info.dropThreshold = 0;
+  empty.info.cls           = 0;
+  empty.epoch              = EMPTY_EPOCH;
+  m_slots.assign(capacity, empty);
+  m_mask     = capacity - 1;
+  m_maxFlows = maxFlows;
+  m_size     = 0;
+  m_stale.clear();
+  m_stale.reserve(maxFlows);
+}
+
+size_t
+ElephantTable::Probe (const FlowField& flow) const
+{
+  size_t slot = FlowFieldHash(flow, ELEPHANT_HASH_SEED) & m_mask;
+  while(m_slots[slot].epoch != EMPTY_EPOCH && !(m_slots[slot].flow == flow))
+    {
+      slot = (slot + 1) & m_mask;
+    }
+  return slot;
+}
+
+const ElephantTable::ElephantInfo_t*
+ElephantTable::Find (const FlowField& flow) const
+{
+  if(m_size == 0)
+    return NULL;
+
+  size_t slot = Probe(flow);
+  return (m_slots[slot].epoch == EMPTY_EPOCH) ? NULL : &m_slots[slot].info;
+}
+
+void
+ElephantTable::BeginUpdate ()
+{
+  if(++m_epoch == EMPTY_EPOCH)
+    {
+      ++m_epoch;
+    }
+}
+
+bool
+ElephantTable::Set (const FlowField& flow, float dropRate, uint8_t cls)
+{
+  NS_ASSERT_MSG(!m_slots.empty(), "ElephantTable is not reserved");
+
+  size_t  slot = Probe(flow);
+  Slot_t& s    = m_slots[slot];
+  if(s.epoch == EMPTY_EPOCH)
+    {
+      if(m_size >= m_maxFlows)
+	{
+	  NS_LOG_WARN("Elephant table is full, " << flow << " stays mice");
+	  return false;
+	}
+      s.flow = flow;
+      ++m_size;
+    }
+  s.info.dropRate      = dropRate;
+  s.info.dropThreshold = DropThreshold(dropRate);
+  s.info.cls           = cls;
+  s.epoch              = m_epoch;
+  return true;
+}
+
+void
+ElephantTable::EndUpdate ()
+{
+  //Collect first, the backward shift moves the slots under the scan
+  m_stale.clear();
+  for(size_t slot = 0; slot < m_slots.size(); ++slot)
+    {
+      const Slot_t& s = m_slots[slot];
+      if(s.epoch != EMPTY_EPOCH && s.epoch != m_epoch)
+	m_stale.push_back(s.flow);
+    }
+
+  for(size_t i = 0; i < m_stale.size(); ++i)
+    {
+      Remove(Probe(m_stale[i]));
+    }
+}
+
+void
+ElephantTable::Remove (size_t slot)
+{
+  NS_ASSERT(m_slots[slot].epoch != EMPTY_EPOCH);
+
+  //Shift back the following slots that can not be found past the hole
+  size_t hole = slot;
+  for(size_t i = (slot + 1) & m_mask;
+      m_slots[i].epoch != EMPTY_EPOCH;
+      i = (i + 1) & m_mask)
+    {
+      size_t home = FlowFieldHash(m_slots[i].flow, ELEPHANT_HASH_SEED) & m_mask;
+      if( ((i - home) & m_mask) >= ((i - hole) & m_mask) )
+	{
+	  m_slots[hole] = m_slots[i];
+	  hole = i;
+	}
+    }
+  m_slots[hole].epoch = EMPTY_EPOCH;
+  --m_size;
+}
+
+void
+ElephantTable::Clear ()
+{
+  for(size_t slot = 0; slot < m_slots.size(); ++slot)
+    {
+      m_slots[slot].epoch = EMPTY_EPOCH;
+    }
+  m_size = 0;
+}
+
+void
+ElephantTable::Print (std::ostream& os) const
+{
+  for(size_t slot = 0; slot < m_slots.size(); ++slot)
+    {
+      const Slot_t& s = m_slots[slot];
+      if(s.epoch != EMPTY_EPOCH)
+	os << s.flow << " class " << (unsigned)s.info.cls << " drop rate " << s.info.dropRate << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,99 @@
+
+#ifndef ELEPHANT_TABLE_H
+#define ELEPHANT_TABLE_H
+
+#include <vector>
+#include <iosfwd>
+
+#include "ns3/flow-field.h"
+
+namespace ns3 {
+
+/* The elephant flow table of a DiffQueue, flow -> drop rate and class(elephant tier).
+ * Flat open addressing with linear probing, the slots are allocated once by
+ * Reserve and never grow, remove is backward shift so there is no tombstone.
+ *
+ * The table is updated by diff every period:
+ *   BeginUpdate(); Set(...) each new elephant; EndUpdate();
+ * Set only writes the slot of a new or changed elephant, EndUpdate removes the
+ * elephants not set since BeginUpdate.
+ */
+class ElephantTable
+{
+public:
+  ElephantTable ();
+
+  /* Allocate the slots for maxFlows elephants, the table is cleared.
+   */
+  void      Reserve (uint32_t maxFlows);
+  uint32_t  GetMaxFlows () const { return m_maxFlows; }
+  uint32_t  GetSize () const { return m_size; }
+
+  struct ElephantInfo_t
+  {
+    float    dropRate;
+    uint32_t dropThreshold;  //DropThreshold(dropRate), precomputed for the AQM
+    uint8_t  cls;            //DiffQueue class of the elephant
+  };
+
+  /* The drop rate scaled to 2^32, drop a packet if a uniform 32 bit random number
+   * is below it.
+   */
+  static uint32_t DropThreshold (float dropRate)
+  {
+    if(dropRate <= 0) return 0;
+    if(dropRate >= 1) return 0xffffffff;
+    return (uint32_t)(dropRate * 4294967296.0);
+  }
+
+  /* The info of the flow, NULL if it is not an elephant.
+   */
+  const ElephantInfo_t* Find (const FlowField& flow) const;
+
+  void      BeginUpdate ();
+  /* Insert or update the elephant, return false if the table is full.
+   */
+  bool      Set (const FlowField& flow, float dropRate, uint8_t cls);
+  void      EndUpdate ();
+
+  void      Clear ();
+  void      Print (std::ostream& os) const;
+
+  /* Walk the elephants slot by slot, for slot in [0, GetNumSlots()),
+   * return false if the slot is empty.
+   */
+  size_t    GetNumSlots () const { return m_slots.size(); }
+  bool      GetSlot (size_t slot, FlowField& flow, ElephantInfo_t& info) const
+  {
+    const Slot_t& s = m_slots[slot];
+    flow = s.flow;
+    info = s.info;
+    return s.epoch != EMPTY_EPOCH;
+  }
+
+private:
+  struct Slot_t
+  {
+    FlowField       flow;
+    ElephantInfo_t  info;
+    uint32_t        epoch;    //the update that set the flow, EMPTY_EPOCH if the slot is empty
+  };
+
+  static const uint32_t EMPTY_EPOCH = 0;
+
+  /* The slot of the flow, or the empty slot it should be inserted in
+   */
+  size_t Probe (const FlowField& flow) const;
+  void   Remove (size_t slot);
+
+  std::vector<Slot_t>     m_slots;
+  size_t                  m_mask;
+  uint32_t                m_maxFlows;
+  uint32_t                m_size;
+  uint32_t                m_epoch;   //current update
+  std::vector<FlowField>  m_stale;   //EndUpdate scratch, m_maxFlows capacity
+};
+
+}
+
+#endif
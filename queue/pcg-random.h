@@ -0,0 +1,49 @@
+
+#ifndef PCG_RANDOM_H
+#define PCG_RANDOM_H
+
+#include <stdint.h>
+
+namespace ns3 {
+
+/* PCG32(XSH RR) random number stream, see www.pcg-random.org.
+ * For the packet path, e.g. the DiffQueue AQM: a few instructions per number
+ * and no shared state, each user owns its stream, so the numbers it gets do
+ * not depend on the other random number users.
+ */
+class Pcg32
+{
+public:
+  Pcg32 ()
+  {
+    Seed (0, 0);
+  }
+
+  /* Streams of different stream ids are independent for the same seed
+   */
+  void Seed (uint64_t seed, uint64_t stream)
+  {
+    m_state = 0;
+    m_inc   = (stream << 1) | 1;
+    Next ();
+    m_state += seed;
+    Next ();
+  }
+
+  uint32_t Next ()
+  {
+    uint64_t old        = m_state;
+    m_state             = old * 6364136223846793005ULL + m_inc;
+    uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+    uint32_t rot        = old >> 59;
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+  }
+
+private:
+  uint64_t m_state;
+  uint64_t m_inc;
+};
+
+}
+
+#endif
@@ -5,12 +5,50 @@
 #include "queue-controller.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/graph-algo.h"
+#include "ns3/flow-hash.h"
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE("QueueController");
 NS_OBJECT_ENSURE_REGISTERED(QueueController);
 
+//The top ELEPHANT_RATIO flows(by bytes) of a queue are the elephants. TODO: How big is the threshold
+static const double ELEPHANT_RATIO = 0.2;
+
+//DiffQueue class config. TODO: How big ?
+static const double   MICE_EXPAND     = 1.2;              //the mice get more than their measured share
+static const uint32_t MTU_BYTES       = 1514;             //min buffer and quantum of a class
+static const uint32_t DRR_ROUND_BYTES = 16 * MTU_BYTES;   //the quantums of all classes in a DRR round
+
+void
+FlowStat::Clear(const FlowInfoVec_t<PckByteCnt>* flows)
+{
+  m_flows = flows;
+  m_flowIdx.clear();
+  m_totalFlowCnt         = 0;
+  m_elephantCnt          = 0;
+  m_miceCnt              = 0;
+  m_elephantPckTotalCnt  = 0;
+  m_elephantByteTotalCnt = 0;
+  m_micePckTotalCnt      = 0;
+  m_miceByteTotalCnt     = 0;
+}
+
+/* Compare the flow indexes by the flows' byte cnt
+ */
+struct FlowIdxByteGreater
+{
+  explicit FlowIdxByteGreater(const FlowInfoVec_t<PckByteCnt>& flows) : m_flows(flows)
+  {}
+  bool operator()(uint32_t i1, uint32_t i2) const
+  {
+    return m_flows[i1].second.m_byteCnt > m_flows[i2].second.m_byteCnt;
+  }
+  const FlowInfoVec_t<PckByteCnt>& m_flows;
+};
+
 TypeId
 QueueController::GetTypeId(void)
 {
@@ -24,8 +62,13 @@ QueueController::GetTypeId(void)
 QueueController::QueueController(int h, int sw) : m_numHost(h), m_numSw(sw)
 {
   NS_LOG_FUNCTION(this<<"numHost" << m_numHost << "numSW" << m_numSw);
-  m_swRouteTable.resize(sw);
+  m_swRouteTable.resize(sw, RouteTable_t(h));
   m_swDiffQueue.resize(sw);
+  m_swFlowStat.resize(sw);
+
+  m_elephantsMetric    = RadarMetrics::RegisterHistogram("queue.elephants");
+  m_elephantDropMetric = RadarMetrics::RegisterHistogram("queue.elephant-drop-ppm");
+  m_elephantFullMetric = RadarMetrics::RegisterCounter("queue.elephants-not-set");
 }
 
 QueueController::~QueueController()
@@ -38,6 +81,7 @@ QueueController::SetSWDiffQueueNum(int swID, int numDiffQ)
   //NS_LOG_INFO("SWID " << swID << " DiffQNum " << numDiffQ << " Set");
   int isw = swID - m_numHost; 
   m_swDiffQueue[isw].resize(numDiffQ, Ptr<DiffQueue>()); 
+  m_swFlowStat[isw].resize(numDiffQ);
 };
 
 void 
@@ -50,26 +94,71 @@ QueueController::RegisterDiffQueue(int swID, int diffQID, Ptr<DiffQueue> diffQ)
 }
 
  
-bool IsIPPredicate(const Ipv4Address& ip, const QueueController::RouteEntry_t e)
+const uint32_t QueueController::RouteTable_t::EMPTY_SLOT;
+
+QueueController::RouteTable_t::RouteTable_t(unsigned numDst)
+{
+  size_t capacity = 16;
+  while(capacity < 2 * (size_t)numDst)
+    {
+      capacity <<= 1;
+    }
+  m_mask = capacity - 1;
+  m_slotIP.assign(capacity, EMPTY_SLOT);
+  m_slotGroup.assign(capacity, 0);
+  m_dstIP.reserve(numDst);
+  m_groups.reserve(numDst);
+}
+
+size_t
+QueueController::RouteTable_t::Probe(uint32_t dstIP) const
+{
+  size_t slot = fmix32(dstIP) & m_mask;
+  while(m_slotIP[slot] != dstIP && m_slotIP[slot] != EMPTY_SLOT)
+    {
+      slot = (slot + 1) & m_mask;
+    }
+  return slot;
+}
+
+std::vector<int>&
+QueueController::RouteTable_t::Insert(uint32_t dstIP)
+{
+  NS_ASSERT(dstIP != EMPTY_SLOT);
+
+  size_t slot = Probe(dstIP);
+  if(m_slotIP[slot] == EMPTY_SLOT)
+    {
+      //The table never grows, keep the load factor <= 1/2
+      NS_ASSERT_MSG(2 * (m_groups.size() + 1) <= m_slotIP.size(), "Route table is full");
+      m_slotIP[slot]    = dstIP;
+      m_slotGroup[slot] = m_groups.size();
+      m_dstIP.push_back(dstIP);
+      m_groups.push_back(std::vector<int>());
+    }
+  return m_groups[m_slotGroup[slot]];
+}
+
+const std::vector<int>*
+QueueController::RouteTable_t::Find(uint32_t dstIP) const
 {
-  return e.first == ip;
+  size_t slot = Probe(dstIP);
+  if(m_slotIP[slot] == EMPTY_SLOT)
+    return NULL;
+  return &m_groups[m_slotGroup[slot]];
 }
 
 void
 QueueController::AddRouteTableEntry(int swID, Ipv4Address ipDstAddr, int swOutPort)
 {
   //NS_LOG_INFO("SWID " << swID <<" DstIP " <<ipDstAddr << " OutPort " <<swOutPort);
-  int isw           = swID - m_numHost; 
-  RouteTable_t& rt  = m_swRouteTable[isw];
-  RouteTable_t::iterator it = std::find_if(rt.begin(), 
-					   rt.end(), 
-					   std::bind1st(std::ptr_fun(&IsIPPredicate), ipDstAddr));
-  if(it != rt.end())
+  int               isw   = swID - m_numHost; 
+  std::vector<int>& ports = m_swRouteTable[isw].Insert(ipDstAddr.Get());
+  //An ECMP group has a few ports
+  if(std::find(ports.begin(), ports.end(), swOutPort) == ports.end())
     {
-      NS_ASSERT(it->second == swOutPort);
-      return;
+      ports.push_back(swOutPort);
     }
-  rt.push_back( RouteEntry_t(ipDstAddr, swOutPort) );
 }
 
 void
@@ -82,10 +171,9 @@ QueueController::ReceiveDecodedFlow(int swID, const FlowInfoVec_t<PckByteCnt>& f
   const RouteTable_t&                 routeTable = m_swRouteTable[swIdx];
   const std::vector<Ptr<DiffQueue> >& diffQueues = m_swDiffQueue[swIdx];
 
-  std::vector<FlowStat> queuesFlowStat; //Flow Statistics for each queue
-  queuesFlowStat.resize(diffQueues.size());
+  std::vector<FlowStat>&              queuesFlowStat = m_swFlowStat[swIdx]; //Flow Statistics for each queue
 
-  ComputeFlowStatistics(flowPckByteInfo, routeTable, queuesFlowStat); //Compute flow statistics for each queue.
+  ComputeFlowStatistics(swID, flowPckByteInfo, routeTable, queuesFlowStat); //Compute flow statistics for each queue.
 
   //Print out the route table to check out
   NS_LOG_INFO("SW " << swID << " Route Table\n" << routeTable);
@@ -97,117 +185,216 @@ void
 QueueController::ConfigQueuesOnSwtch(const std::vector<FlowStat>& queuesFlowStat, 
 				     const std::vector<Ptr<DiffQueue> >& queues)
 {
+  std::vector<uint64_t> classPcks;
+  std::vector<uint64_t> classBytes;
   
   for(size_t i = 0; i < queues.size(); ++i)
     {
       const FlowStat& flowStat  = queuesFlowStat[i];    
       Ptr<DiffQueue>  diffQueue = queues[i];
-
-      //1.Set the ElephantFlowInfo of the diffQueue
-      diffQueue->ClearElephantFlowInfo();
-      for(size_t ie = 0; ie < flowStat.m_elephantCnt; ++ie)
+      //An idle queue drops the last period's elephants and goes back to mice only
+      bool            idle      = flowStat.m_micePckTotalCnt + flowStat.m_elephantPckTotalCnt == 0;
+
+      //1.Update the ElephantFlowInfo of the diffQueue, the biggest elephants if the table can't hold all.
+      //The elephants are split into the elephant classes(tiers) by byte rank, the biggest in class 1.
+      size_t numClasses  = diffQueue->GetNumClasses();
+      size_t numTiers    = numClasses - 1;
+      size_t numElephant = idle ? 0 : std::min<size_t>(flowStat.m_elephantCnt, diffQueue->GetMaxElephantFlows());
+      classPcks.assign(numClasses, 0);
+      classBytes.assign(numClasses, 0);
+      diffQueue->BeginElephantFlowUpdate();
+      for(size_t ie = 0; ie < numElephant; ++ie)
 	{
-	  const FlowField&  eflow   = flowStat.m_sortedFlowPckByteInfo[ie].first;
-	  uint32_t          pckCnt  = flowStat.m_sortedFlowPckByteInfo[ie].second.m_packetCnt;
-	  //uint64_t          byteCnt = flowStat.m_sortedFlowPckByteInfo[ie].second.m_byteCnt;
+	  const FlowField&  eflow   = flowStat.GetFlow(ie).first;
+	  const PckByteCnt& pb      = flowStat.GetFlow(ie).second;
+	  uint8_t           cls     = DiffQueue::MICE_CLASS + 1 + ie * numTiers / numElephant;
 
 	  //Calculate the drop rate
-	  float droprate = (float) pckCnt / (float) flowStat.m_elephantPckTotalCnt;
-	  diffQueue->SetElephantFlowInfo( eflow, droprate );
+	  float droprate = (float) pb.m_packetCnt / (float) flowStat.m_elephantPckTotalCnt;
+	  if(!diffQueue->SetElephantFlowInfo( eflow, droprate, cls ))
+	    RadarMetrics::Add(m_elephantFullMetric);
+	  RadarMetrics::Record(m_elephantDropMetric, (uint64_t)(droprate * 1e6));
+	  classPcks[cls]  += pb.m_packetCnt;
+	  classBytes[cls] += pb.m_byteCnt;
 	}
+      diffQueue->EndElephantFlowUpdate();
+      RadarMetrics::Record(m_elephantsMetric, numElephant);
 
-      //2.Set the elephant mice maxPackets of the diffQueue
-      uint64_t totalPck    = flowStat.m_micePckTotalCnt + flowStat.m_elephantPckTotalCnt;
-      float    micePercent = (float) flowStat.m_micePckTotalCnt / (float) totalPck;
-      //TODO: How big ?
-      float miceExpand  = 1.2;
-      micePercent *= miceExpand;
-
-      uint32_t queueTotalMaxPackets    = diffQueue->GetMaxPackets();
-      uint32_t queueMiceMaxPackets     = queueTotalMaxPackets * micePercent;
-      uint32_t queueElephantMaxPackets = queueTotalMaxPackets - queueMiceMaxPackets;
+      //The elephants not in the table go to the mice class
+      uint64_t elephantPck   = 0;
+      uint64_t elephantByte  = 0;
+      for(size_t cls = DiffQueue::MICE_CLASS + 1; cls < numClasses; ++cls)
+	{
+	  elephantPck  += classPcks[cls];
+	  elephantByte += classBytes[cls];
+	}
 
-      NS_ASSERT(queueMiceMaxPackets > 0);
-      NS_ASSERT(queueElephantMaxPackets > 0);
+      //2.Share the buffer and the DRR quantums by the measured bytes(the packet limits by packets).
+      //The mice share is expanded, the elephant classes share the rest. Idle, the mice take all.
+      double micePckShare  = 1.0;
+      double miceByteShare = 1.0;
+      if(idle)
+	{
+	  NS_LOG_INFO("Queue " << i << " no flow measured, mice only");
+	}
+      else
+	{
+	  uint64_t totalPck  = flowStat.m_micePckTotalCnt + flowStat.m_elephantPckTotalCnt;
+	  uint64_t totalByte = flowStat.m_miceByteTotalCnt + flowStat.m_elephantByteTotalCnt;
+	  classPcks[DiffQueue::MICE_CLASS]  = totalPck - elephantPck;
+	  classBytes[DiffQueue::MICE_CLASS] = totalByte - elephantByte;
+	  micePckShare  = std::min(1.0, MICE_EXPAND * classPcks[DiffQueue::MICE_CLASS] / totalPck);
+	  miceByteShare = (totalByte == 0) ? micePckShare :
+	    std::min(1.0, MICE_EXPAND * classBytes[DiffQueue::MICE_CLASS] / totalByte);
+	}
 
-      diffQueue->SetMiceMaxPackets( queueMiceMaxPackets );
-      diffQueue->SetElephantMaxPackets( queueElephantMaxPackets );
+      uint32_t queueTotalMaxPackets = diffQueue->GetMaxPackets();
+      uint64_t queueTotalMaxBytes   = diffQueue->GetMaxBytes();
+      for(size_t cls = 0; cls < numClasses; ++cls)
+	{
+	  double pckShare  = micePckShare;
+	  double byteShare = miceByteShare;
+	  if(cls != DiffQueue::MICE_CLASS)
+	    {
+	      pckShare  = (elephantPck == 0)  ? 0 : (1 - micePckShare) * classPcks[cls] / elephantPck;
+	      byteShare = (elephantByte == 0) ? 0 : (1 - miceByteShare) * classBytes[cls] / elephantByte;
+	    }
+
+	  diffQueue->SetClassMaxPackets(cls, std::max<uint32_t>(1, queueTotalMaxPackets * pckShare));
+	  diffQueue->SetClassMaxBytes(cls, std::max<uint64_t>(MTU_BYTES, queueTotalMaxBytes * byteShare));
+	  diffQueue->SetClassQuantum(cls, std::max<uint32_t>(MTU_BYTES, DRR_ROUND_BYTES * byteShare));
+	}
 
-      //3.Set the elephant mice bandwidth()
-      uint16_t totalWeight   = diffQueue->GetTotalWeight();
-      uint16_t newMiceWeight = totalWeight * micePercent;
-      if(newMiceWeight >= totalWeight)
+      NS_LOG_INFO("Queue " << i << " FlowStat\n" << flowStat);       
+      for(size_t cls = 0; cls < numClasses; ++cls)
 	{
-	  newMiceWeight = totalWeight - 2;
+	  NS_LOG_INFO("class " << cls <<
+		      " new maxPackets: " << diffQueue->GetClassMaxPackets(cls) <<
+		      " new maxBytes: "   << diffQueue->GetClassMaxBytes(cls) <<
+		      " new quantum: "    << diffQueue->GetClassQuantum(cls));
 	}
-      else if(newMiceWeight == 0)
+    }
+}
+
+void
+QueueController::StartTelemetry(Time period, Time end)
+{
+  NS_LOG_FUNCTION(this << period << end);
+  m_telemetryPeriod = period;
+  m_telemetryEnd    = end;
+  Simulator::Schedule (m_telemetryPeriod, &QueueController::SampleTelemetry, this);
+}
+
+void
+QueueController::SampleTelemetry()
+{
+  for(size_t isw = 0; isw < m_swDiffQueue.size(); ++isw)
+    {
+      const std::vector<Ptr<DiffQueue> >& diffQueues = m_swDiffQueue[isw];
+      for(size_t i = 0; i < diffQueues.size(); ++i)
 	{
-	  newMiceWeight = 2;
+	  if(!diffQueues[i])
+	    continue;
+	  diffQueues[i]->SampleClassStats(m_classStats);
+	  ReactToBurst(diffQueues[i], m_classStats);
 	}
-      diffQueue->SetMiceWeight(newMiceWeight);
+    }
 
-      NS_LOG_INFO("Queue " << i << " FlowStat\n" << flowStat);       
-      NS_LOG_INFO("new mice maxPackets: " << diffQueue->GetMiceMaxPackets());
-      NS_LOG_INFO("new elep maxPackets: " << diffQueue->GetElephantMaxPackets());
-      NS_LOG_INFO("new mice BD: " << diffQueue->GetMiceWeight() << 
-		  " Total BD: "   << diffQueue->GetTotalWeight());
-      diffQueue->PrintElephantFlowInfo();      
+  if(Simulator::Now() + m_telemetryPeriod < m_telemetryEnd)
+    {
+      Simulator::Schedule (m_telemetryPeriod, &QueueController::SampleTelemetry, this);
     }
 }
 
+void
+QueueController::ReactToBurst(Ptr<DiffQueue> diffQueue, const std::vector<DiffQueue::ClassStats_t>& stats)
+{
+  const DiffQueue::ClassStats_t& mice = stats[DiffQueue::MICE_CLASS];
+  if(mice.droppedPcks == 0)
+    return;
+
+  uint32_t lentPcks  = 0;
+  uint64_t lentBytes = 0;
+  for(size_t cls = DiffQueue::MICE_CLASS + 1; cls < stats.size(); ++cls)
+    {
+      uint32_t maxPcks  = diffQueue->GetClassMaxPackets(cls);
+      uint64_t maxBytes = diffQueue->GetClassMaxBytes(cls);
+      uint32_t idlePcks  = (maxPcks > stats[cls].maxDepthPcks) ? (maxPcks - stats[cls].maxDepthPcks) / 2 : 0;
+      uint64_t idleBytes = (maxBytes > stats[cls].maxDepthBytes) ? (maxBytes - stats[cls].maxDepthBytes) / 2 : 0;
+
+      //Keep at least the minimum buffer of the class
+      idlePcks  = std::min<uint32_t>(idlePcks, maxPcks - 1);
+      idleBytes = std::min<uint64_t>(idleBytes, maxBytes - std::min<uint64_t>(maxBytes, MTU_BYTES));
+
+      diffQueue->SetClassMaxPackets(cls, maxPcks - idlePcks);
+      diffQueue->SetClassMaxBytes(cls, maxBytes - idleBytes);
+      lentPcks  += idlePcks;
+      lentBytes += idleBytes;
+    }
+
+  if(lentPcks == 0 && lentBytes == 0)
+    return;
+
+  diffQueue->SetClassMaxPackets(DiffQueue::MICE_CLASS, diffQueue->GetClassMaxPackets(DiffQueue::MICE_CLASS) + lentPcks);
+  diffQueue->SetClassMaxBytes(DiffQueue::MICE_CLASS, diffQueue->GetClassMaxBytes(DiffQueue::MICE_CLASS) + lentBytes);
+  NS_LOG_INFO("SW " << diffQueue->GetSWID() << " queue " << diffQueue->GetPortID() <<
+	      " mice dropped " << mice.droppedPcks << " packets, lend it " <<
+	      lentPcks << " packets " << lentBytes << " bytes");
+}
 
 void
-QueueController::ComputeFlowStatistics(const FlowInfoVec_t<PckByteCnt>& flowPckByteInfo, 
+QueueController::ComputeFlowStatistics(int swID,
+				       const FlowInfoVec_t<PckByteCnt>& flowPckByteInfo, 
 				       const RouteTable_t& routeTable, 
 				       std::vector<FlowStat>& queuesFlowStat)
 {
 
-  //Divide flows into different queues.
-  for(FlowInfoVec_t<PckByteCnt>::const_iterator it = flowPckByteInfo.begin();
-      it != flowPckByteInfo.end();
-      ++it)
+  for(size_t i = 0; i < queuesFlowStat.size(); ++i)
     {
-      const Ipv4Address& ipDst = Ipv4Address((it->first).ipv4dstip);
+      queuesFlowStat[i].Clear(&flowPckByteInfo);
+    }
 
-      //Using the route table to find the according queue it belongs to.
-      size_t i = 0;
-      for(; i < routeTable.size(); ++i)
-	{
-	  if(routeTable[i].first == ipDst) break;
-	}
-      NS_ASSERT(i < routeTable.size()); //ensure we found an entry
-      int queueId = routeTable[i].second;
+  //Divide flows into different queues, all flows are mice until the elephants are selected.
+  for(size_t iflow = 0; iflow < flowPckByteInfo.size(); ++iflow)
+    {
+      const std::pair<FlowField, PckByteCnt>& flow = flowPckByteInfo[iflow];
 
-      queuesFlowStat[queueId].m_sortedFlowPckByteInfo.push_back(*it);
+      //Using the route table to find the according queue it belongs to.
+      const std::vector<int>* ports = routeTable.Find(flow.first.ipv4dstip);
+      NS_ASSERT(ports && !ports->empty()); //ensure we found an entry
+      unsigned way     = Graph::EcmpWay(FlowFieldHash(flow.first, ECMP_HASH_SEED));
+      int      queueId = (*ports)[Graph::EcmpSelect(way, swID, ports->size())];
+
+      FlowStat& flowStat = queuesFlowStat[queueId];
+      flowStat.m_flowIdx.push_back(iflow);
+      flowStat.m_micePckTotalCnt  += flow.second.m_packetCnt;
+      flowStat.m_miceByteTotalCnt += flow.second.m_byteCnt;
     }
 
-  //Compute each queues flow statistics
+  //Select each queue's elephants
+  FlowIdxByteGreater byteGreater(flowPckByteInfo);
   for(size_t i = 0; i < queuesFlowStat.size(); ++i)
     {
       FlowStat& flowStat = queuesFlowStat[i];
-      std::sort(flowStat.m_sortedFlowPckByteInfo.begin(),
-		flowStat.m_sortedFlowPckByteInfo.end(),
-		PckByteCntByteGreater());
       
-      flowStat.m_totalFlowCnt = flowStat.m_sortedFlowPckByteInfo.size();
-      flowStat.m_elephantCnt  = flowStat.m_totalFlowCnt * 0.2; //TODO: How big is the threshold
+      flowStat.m_totalFlowCnt = flowStat.m_flowIdx.size();
+      flowStat.m_elephantCnt  = flowStat.m_totalFlowCnt * ELEPHANT_RATIO;
       flowStat.m_miceCnt      = flowStat.m_totalFlowCnt - flowStat.m_elephantCnt;
+      if(flowStat.m_elephantCnt == 0)
+	continue;
+
+      std::vector<uint32_t>::iterator elephantEnd = flowStat.m_flowIdx.begin() + flowStat.m_elephantCnt;
+      std::nth_element(flowStat.m_flowIdx.begin(), elephantEnd, flowStat.m_flowIdx.end(), byteGreater);
+      std::sort(flowStat.m_flowIdx.begin(), elephantEnd, byteGreater);
 
-      size_t i = 0;
-      for(; i < flowStat.m_elephantCnt; ++i)
+      for(size_t ie = 0; ie < flowStat.m_elephantCnt; ++ie)
 	{
-	  const PckByteCnt& pb = flowStat.m_sortedFlowPckByteInfo[i].second;
+	  const PckByteCnt& pb = flowStat.GetFlow(ie).second;
 	  flowStat.m_elephantPckTotalCnt  += pb.m_packetCnt;
 	  flowStat.m_elephantByteTotalCnt += pb.m_byteCnt; 
 	}
-      
-      for(; i < flowStat.m_totalFlowCnt; ++i)
-	{
-	  const PckByteCnt& pb = flowStat.m_sortedFlowPckByteInfo[i].second;
-	  flowStat.m_micePckTotalCnt  += pb.m_packetCnt;
-	  flowStat.m_miceByteTotalCnt += pb.m_byteCnt; 
-	}
-
+      flowStat.m_micePckTotalCnt  -= flowStat.m_elephantPckTotalCnt;
+      flowStat.m_miceByteTotalCnt -= flowStat.m_elephantByteTotalCnt;
     }
 
 }
@@ -226,12 +413,12 @@ operator<<(std::ostream& os, const FlowStat& stat)
   os << "E:\n";
   for(size_t i = 0; i < stat.m_elephantCnt; ++i)
     {
-      os << stat.m_sortedFlowPckByteInfo[i].first << " " << stat.m_sortedFlowPckByteInfo[i].second << "\n";
+      os << stat.GetFlow(i).first << " " << stat.GetFlow(i).second << "\n";
     }
   os << "M:\n";
   for(size_t i = stat.m_elephantCnt; i < stat.m_miceCnt + stat.m_elephantCnt; ++i)
     {
-      os << stat.m_sortedFlowPckByteInfo[i].first << " " << stat.m_sortedFlowPckByteInfo[i].second << "\n";
+      os << stat.GetFlow(i).first << " " << stat.GetFlow(i).second << "\n";
     }
   os << "----------------Flow End-----------------";
   return os;
@@ -240,9 +427,14 @@ operator<<(std::ostream& os, const FlowStat& stat)
 std::ostream& 
 operator<<(std::ostream& os, const QueueController::RouteTable_t& rt)
 {
-  for(size_t i = 0; i < rt.size(); ++i)
+  for(size_t i = 0; i < rt.m_groups.size(); ++i)
     {
-      os << "Dst " << rt[i].first << " Port " << rt[i].second << "\n"; 
+      os << "Dst " << Ipv4Address(rt.m_dstIP[i]) << " Port";
+      for(size_t ip = 0; ip < rt.m_groups[i].size(); ++ip)
+	{
+	  os << " " << rt.m_groups[i][ip];
+	}
+      os << "\n";
     }
   
   return os;
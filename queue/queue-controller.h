@@ -8,26 +8,39 @@
 #include <iosfwd>
 
 #include "ns3/object.h"
+#include "ns3/nstime.h"
 #include "ns3/flow-field.h"  
+#include "ns3/diff-queue.h"
+#include "ns3/radar-metrics.h"
 
 namespace ns3 {
 
 class Ipv4Address;
-class DiffQueue;
 
 /* FlowStat is the mice elephant flow info that each queue should have(because these info is measured
  * before enqueue.).
+ * The flows are not copied, m_flowIdx indexes the decoded flows of the switch.
  */
 
 struct FlowStat  
 {
   /*TODO: may compute other statistics*/
-  FlowStat() : m_elephantCnt(0), m_miceCnt(0),
+  FlowStat() : m_flows(NULL), m_totalFlowCnt(0), m_elephantCnt(0), m_miceCnt(0),
 	       m_elephantPckTotalCnt(0), m_elephantByteTotalCnt(0),
 	       m_micePckTotalCnt(0), m_miceByteTotalCnt(0)
   {}
+
+  /* Reset for the next period, keep the capacity of m_flowIdx
+   */
+  void Clear(const FlowInfoVec_t<PckByteCnt>* flows);
+
+  const std::pair<FlowField, PckByteCnt>& GetFlow(size_t i) const
+  {
+    return (*m_flows)[m_flowIdx[i]];
+  }
   
-  FlowInfoVec_t<PckByteCnt> m_sortedFlowPckByteInfo;
+  const FlowInfoVec_t<PckByteCnt>* m_flows;   //decoded flows of the switch, valid in ReceiveDecodedFlow only
+  std::vector<uint32_t>            m_flowIdx; //the queue's flows, the first m_elephantCnt are the elephants in byte descending order
   uint32_t m_totalFlowCnt;
   uint32_t m_elephantCnt;  //elephant flows
   uint32_t m_miceCnt;      //mice flows
@@ -53,19 +66,54 @@ public:
 
   void RegisterDiffQueue(int swID, int diffQID, Ptr<DiffQueue> diffQ);
   
+  /* Add swOutPort to the switch's ECMP next hop group of ipDstAddr
+   */
   void AddRouteTableEntry(int swID, Ipv4Address ipDstAddr, int swOutPort);
 
   /* Callback function call by matrix decoder
    */
   void ReceiveDecodedFlow(int swID, const FlowInfoVec_t<PckByteCnt>& flowPckByteInfo);
 
+  /* Sample the diff queues' class counters every period until end.
+   * The decoded flows reconfigure the queues once a decode period, the telemetry
+   * reacts to the bursts in between.
+   */
+  void StartTelemetry(Time period, Time end);
   
 private:
-  typedef std::pair<Ipv4Address, int>  RouteEntry_t;
-  typedef std::vector<RouteEntry_t>    RouteTable_t;
+  /* A switch's dst ip -> ECMP group ports map, open addressing with linear probing.
+   * The capacity is fixed when constructed(at least twice the dsts), the table is
+   * filled once at startup and never rehashed.
+   */
+  class RouteTable_t
+  {
+  public:
+    explicit RouteTable_t(unsigned numDst = 0);
+
+    /* The ECMP group of dstIP, an empty group is inserted if not found
+     */
+    std::vector<int>&       Insert(uint32_t dstIP);
+    /* The ECMP group of dstIP, NULL if not found
+     */
+    const std::vector<int>* Find(uint32_t dstIP) const;
+
+  private:
+    friend std::ostream& operator<<(std::ostream& os, const RouteTable_t& rt);
+
+    static const uint32_t EMPTY_SLOT = 0xffffffff;
+
+    /* The slot of dstIP, or the empty slot it should be inserted in
+     */
+    size_t Probe(uint32_t dstIP) const;
+
+    std::vector<uint32_t>           m_slotIP;     //EMPTY_SLOT(broadcast addr) if empty
+    std::vector<uint32_t>           m_slotGroup;  //idx in m_groups
+    size_t                          m_mask;
+    std::vector<uint32_t>           m_dstIP;      //dst ip of each group, insert order
+    std::vector<std::vector<int> >  m_groups;
+  };
 
   friend std::ostream& operator<<(std::ostream& os, const RouteTable_t& rt);
-  friend bool IsIPPredicate(const Ipv4Address& ip, const RouteEntry_t e);
 
   /* Use computed flow statistics to config the diffqueues 
    * on the specified switch.
@@ -74,18 +122,42 @@ private:
 			   const std::vector<Ptr<DiffQueue> >& queues);
   /* Compute flow statistics for each queue on the swtch.
    * We divide the flowPckByteInfo into different group according to the routeTable.
-   * Each group matches a a queue(port) of a switch
+   * Each group matches a a queue(port) of a switch, a flow's port in the ECMP group
+   * is picked the same way as Graph::GetPath.
+   * The flows are streamed into the queues' accumulators in one pass, the elephants
+   * (top ELEPHANT_RATIO by bytes) are selected by nth_element, only they are sorted.
    */
-  void ComputeFlowStatistics(const FlowInfoVec_t<PckByteCnt>& flowPckByteInfo,
+  void ComputeFlowStatistics(int swID,
+			     const FlowInfoVec_t<PckByteCnt>& flowPckByteInfo,
 			     const RouteTable_t& routeTable, 
 			     std::vector<FlowStat>& queuesFlowStat);
 
+  /* Sample all the diff queues and react, reschedule until m_telemetryEnd
+   */
+  void SampleTelemetry();
+
+  /* The mice class of the queue dropped packets in the last sample interval:
+   * lend it half of each elephant class's unused buffer(limit - max depth).
+   * The next ReceiveDecodedFlow resets the shares.
+   */
+  void ReactToBurst(Ptr<DiffQueue> diffQueue, const std::vector<DiffQueue::ClassStats_t>& stats);
+
   int                                         m_numHost;
   int                                         m_numSw;
   std::vector<RouteTable_t>                   m_swRouteTable; 
-  //the idx of swID is (swID - m_numHost), it stores the sw's route table(dst ip addr - port to output)
+  //the idx of swID is (swID - m_numHost), it stores the sw's route table(dst ip addr - ports to output)
   std::vector<std::vector<Ptr<DiffQueue> > >  m_swDiffQueue;
   //the idx of swID is (swID - m_numHost), it stores the sw's queue, we use the port number to index the queue
+  std::vector<std::vector<FlowStat> >         m_swFlowStat;
+  //the idx of swID is (swID - m_numHost), the sw's queues' flow statistics, reused every period
+
+  Time                                        m_telemetryPeriod;
+  Time                                        m_telemetryEnd;
+  std::vector<DiffQueue::ClassStats_t>        m_classStats;  //SampleTelemetry scratch
+
+  RadarMetrics::MetricId_t                    m_elephantsMetric;     //elephants set per queue config
+  RadarMetrics::MetricId_t                    m_elephantDropMetric;  //elephant drop rates in ppm
+  RadarMetrics::MetricId_t                    m_elephantFullMetric;  //elephants not set, the table is full
 };
 
 std::ostream& operator<<(std::ostream& os, const QueueController::RouteTable_t& rt);
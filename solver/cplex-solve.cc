@@ -3,6 +3,8 @@
 #include <cassert>
 #include <iostream>
 
+#include "ns3/stage-timer.h"
+
 #include <ilcplex/ilocplex.h>
 #include <ilconcert/iloenv.h>
 ILOSTLBEGIN
@@ -12,17 +14,19 @@ namespace ns3
 
 void CplexSolveEquations(const std::vector<std::vector<uint16_t> >& cntIdToVarId,
 			 const std::vector<uint32_t>& cnt,
-			 std::vector<uint32_t>& var)
+			 std::vector<uint32_t>& var,
+			 int numThreads)
 {
+  STAGE_TIMER(STAGE_CPLEX_SOLVE);
 
   assert(cntIdToVarId.size() == cnt.size());
 
+  size_t varSize = var.size();
+  if(varSize == 0) return;
+
   IloEnv env;
   try 
     {
-      size_t varSize = var.size();
-      if(varSize == 0) return;
-
       IloModel model(env);
 
       //Unknown vars to solve
@@ -52,6 +56,9 @@ void CplexSolveEquations(const std::vector<std::vector<uint16_t> >& cntIdToVarId
 
       //Solve
       IloCplex cplex(model);
+      //The parallel callers(e.g. the offline decoder's workers) set 1, else the
+      //threads of all the calls oversubscribe the cores
+      cplex.setParam(IloCplex::Threads, numThreads);
       if( !cplex.solve() )
 	{
 	  std::cerr << "Fail to solve" << std::endl;
@@ -72,6 +79,9 @@ void CplexSolveEquations(const std::vector<std::vector<uint16_t> >& cntIdToVarId
       exit(0);
     }
 
+  //Free the model, the cplex and the arrays of this call
+  env.end();
+
 }
 
 }